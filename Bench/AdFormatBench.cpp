@@ -0,0 +1,162 @@
+// Checks and times the lobby ad wire format: round-trips ads like the ones create_ad builds, fuzzes
+// the decoder with mutated and random input, compares the bytes on the wire with the raw AdFile
+// older clients send and measures encode/decode throughput.
+#include "../SNP/Common.h"
+
+#include <random>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+struct SampleAd {
+	const char* name;
+	AdFile ad;
+};
+
+// Same fields create_ad fills in
+static AdFile make_ad(const char* game_name, const char* stat_string, u32 game_state, const std::vector<u8>& extra) {
+	AdFile ad{};
+	ad.crownlink_mode = CrownLinkMode::CLNK;
+	snprintf(ad.game_info.game_name, sizeof(ad.game_info.game_name), "%s", game_name);
+	snprintf(ad.game_info.game_description, sizeof(ad.game_info.game_description), "%s", stat_string);
+	ad.game_info.game_state = game_state;
+	ad.game_info.program_id = 'SEXP';
+	ad.game_info.version_id = 0xd5;
+	ad.game_info.host_latency = 0x0050;
+	ad.game_info.category_bits = 0x00a7;
+	memcpy(ad.extra_bytes, extra.data(), extra.size());
+	ad.game_info.extra_bytes = (u32)extra.size();
+	return ad;
+}
+
+static std::vector<SampleAd> sample_ads() {
+	const std::vector<u8> lobby_extra{0x0c, 0, 0, 0, 0x02, 0, 0, 0, 0x01, 0, 0, 0, 0x08, 0, 0, 0};
+	const std::vector<u8> status_extra(32, 0);
+	AdFile longest = make_ad(std::string(200, 'n').c_str(), std::string(200, 'd').c_str(), 12, std::vector<u8>(32, 0xff));
+	longest.crownlink_mode = CrownLinkMode::DBCL;
+	longest.game_info.creation_time = 0xffffffff;
+	return {
+		{"lobby", make_ad("Fastest", ",44,,3,,1e,,1,cb2edaab,1,,Jesse\rAxiom\r", 0, lobby_extra)},
+		{"in progress", make_ad("BGH 3v3", ",33,,3,,1e,,1,cb2edaab,5,,Jesse\r(8)Big Game Hunters\r", 12, lobby_extra)},
+		{"status", make_ad("CrownLink: connected", ",33,,3,,1e,,1,cb2edaab,5,,Server\rStatus\r", 0, status_extra)},
+		{"longest", longest},
+	};
+}
+
+static bool same_ad(const AdFile& a, const AdFile& b) {
+	const auto& x = a.game_info;
+	const auto& y = b.game_info;
+	return x.game_state == y.game_state && x.creation_time == y.creation_time && x.host_latency == y.host_latency
+		&& x.category_bits == y.category_bits && x.program_id == y.program_id && x.version_id == y.version_id
+		&& x.extra_bytes == y.extra_bytes && a.crownlink_mode == b.crownlink_mode
+		&& !strcmp(x.game_name, y.game_name) && !strcmp(x.game_description, y.game_description)
+		&& !memcmp(a.extra_bytes, b.extra_bytes, sizeof(a.extra_bytes));
+}
+
+// The game DLL is 32 bit, there an AdFile is smaller than in a 64 bit build of this bench
+constexpr size_t RAW_AD_SIZE_32 = 352;
+
+static bool check_samples(const std::vector<SampleAd>& ads) {
+	bool ok = true;
+	printf("%-12s %8s %8s %10s %10s %7s %4s\n", "ad", "raw32", "compact", "raw32 b64", "comp b64", "ratio", "ok");
+	for (const auto& [name, ad] : ads) {
+		const auto encoded = ad_format::encode(ad);
+		AdFile decoded;
+		bool round_trip = ad_format::decode(encoded, decoded) && same_ad(ad, decoded);
+
+		// What an older host sends still decodes
+		AdFile from_raw;
+		round_trip &= ad_format::decode(std::string_view{(const char*)&ad, sizeof(ad)}, from_raw) && same_ad(ad, from_raw);
+
+		const auto raw_b64 = (RAW_AD_SIZE_32 + 2) / 3 * 4;
+		const auto compact_b64 = base64::to_base64(encoded).size();
+		printf("%-12s %8zu %8zu %10zu %10zu %6.1f%% %4s\n", name, RAW_AD_SIZE_32, encoded.size(), raw_b64, compact_b64,
+			100.0 * encoded.size() / RAW_AD_SIZE_32, round_trip ? "yes" : "NO");
+		ok &= round_trip;
+	}
+	printf("raw AdFile in this build: %zu bytes\n", sizeof(AdFile));
+	return ok;
+}
+
+// Whatever the input, decode() must stay inside it and leave terminated strings behind
+static bool fuzz(const std::vector<SampleAd>& ads, u32 iterations) {
+	std::mt19937 rng{4919};
+	u64 decoded = 0;
+	for (u32 i = 0; i < iterations; i++) {
+		std::string input;
+		if (i % 2) {
+			input = ad_format::encode(ads[rng() % ads.size()].ad);
+			const auto mutations = 1 + rng() % 4;
+			for (u32 m = 0; m < mutations; m++) {
+				input[2 + rng() % (input.size() - 2)] = (char)rng();
+			}
+			input.resize(rng() % (input.size() + 8), 0);
+		} else {
+			input.resize(rng() % 400);
+			for (auto& c : input) {
+				c = (char)rng();
+			}
+			if (rng() % 2 && input.size() >= 2) {
+				input[0] = (char)ad_format::AD_FORMAT_MAGIC;
+				input[1] = ad_format::AD_FORMAT_VERSION;
+			}
+		}
+
+		// Sized exactly to the input so a sanitizer build flags any read past the end
+		const auto data = std::make_unique<char[]>(input.size());
+		std::copy(input.begin(), input.end(), data.get());
+		AdFile ad;
+		if (!ad_format::decode(std::string_view{data.get(), input.size()}, ad)) {
+			continue;
+		}
+		decoded++;
+		if (ad_format::is_encoded(input) && (strnlen(ad.game_info.game_name, sizeof(ad.game_info.game_name)) == sizeof(ad.game_info.game_name)
+				|| strnlen(ad.game_info.game_description, sizeof(ad.game_info.game_description)) == sizeof(ad.game_info.game_description)
+				|| ad.game_info.extra_bytes > sizeof(ad.extra_bytes))) {
+			printf("fuzz: decoded ad without terminated strings\n");
+			return false;
+		}
+	}
+	printf("fuzz: %u inputs, %llu decoded\n", iterations, decoded);
+	return true;
+}
+
+static void throughput(const std::vector<SampleAd>& ads, u32 rounds) {
+	std::vector<std::string> encoded;
+	u64 bytes = 0;
+	auto start = Clock::now();
+	for (u32 round = 0; round < rounds; round++) {
+		for (const auto& sample : ads) {
+			bytes += ad_format::encode(sample.ad).size();
+		}
+	}
+	const auto encode_s = std::chrono::duration<f64>(Clock::now() - start).count();
+
+	for (const auto& sample : ads) {
+		encoded.push_back(ad_format::encode(sample.ad));
+	}
+	u64 states = 0;
+	AdFile ad;
+	start = Clock::now();
+	for (u32 round = 0; round < rounds; round++) {
+		for (const auto& data : encoded) {
+			ad_format::decode(data, ad);
+			states += ad.game_info.game_state;
+		}
+	}
+	const auto decode_s = std::chrono::duration<f64>(Clock::now() - start).count();
+
+	const auto total = (f64)rounds * ads.size();
+	printf("encode: %.1f M ads/s, %.0f ns/ad (%llu)\n", total / encode_s / 1e6, encode_s * 1e9 / total, bytes);
+	printf("decode: %.1f M ads/s, %.0f ns/ad (%llu)\n", total / decode_s / 1e6, decode_s * 1e9 / total, states);
+}
+
+int main(int argc, char** argv) {
+	const u32 iterations = argc > 1 ? (u32)std::stoul(argv[1]) : 1'000'000;
+	const auto ads = sample_ads();
+
+	const bool samples_ok = check_samples(ads);
+	const bool fuzz_ok = fuzz(ads, iterations);
+	throughput(ads, 1'000'000);
+	return samples_ok && fuzz_ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// Checks and times fast_base64 against include/base64.hpp: both must agree on every encoding and on
+// which inputs are malformed, then peer IDs and ad-sized payloads are encoded and decoded with each.
+// Build with CROWNLINK_SIMD for the SSSE3 blocks, the scalar path is measured otherwise.
+#include "../SNP/Common.h"
+
+#include <random>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+static bool check(u32 iterations) {
+	std::mt19937 rng{6464};
+	u64 mismatches = 0;
+	for (u32 i = 0; i < iterations; i++) {
+		std::string data(rng() % 600, '\0');
+		for (auto& c : data) {
+			c = (char)rng();
+		}
+		const auto expected = base64::to_base64(data);
+		std::string text = fast_base64::to_base64(data);
+		if (text != expected || fast_base64::from_base64(text) != data) {
+			printf("mismatch encoding %zu bytes\n", data.size());
+			mismatches++;
+		}
+		if (data.size() == fast_base64::ADDRESS_SIZE) {
+			char id[fast_base64::ADDRESS_CHARS];
+			u8 address[fast_base64::ADDRESS_SIZE];
+			fast_base64::encode_address((const u8*)data.data(), id);
+			if (std::string_view{id, sizeof(id)} != expected || !fast_base64::decode_address(expected, address)
+					|| memcmp(address, data.data(), sizeof(address))) {
+				printf("mismatch on a peer ID\n");
+				mismatches++;
+			}
+		}
+
+		// Both have to reject the same corrupted input
+		if (!text.empty()) {
+			text[rng() % text.size()] = (char)rng();
+			std::string original, fast;
+			bool original_threw = false, fast_threw = false;
+			try { original = base64::from_base64(text); } catch (const std::exception&) { original_threw = true; }
+			try { fast = fast_base64::from_base64(text); } catch (const std::exception&) { fast_threw = true; }
+			if (original_threw != fast_threw || original != fast) {
+				printf("mismatch decoding corrupted input of %zu chars\n", text.size());
+				mismatches++;
+			}
+		}
+	}
+	printf("check: %u inputs, %llu mismatches\n", iterations, mismatches);
+	return mismatches == 0;
+}
+
+template <typename F>
+static f64 ns_per_call(u32 rounds, F&& f) {
+	const auto start = Clock::now();
+	for (u32 i = 0; i < rounds; i++) {
+		f(i);
+	}
+	return std::chrono::duration<f64, std::nano>(Clock::now() - start).count() / rounds;
+}
+
+static void throughput(u32 rounds) {
+	std::mt19937 rng{1};
+	printf("%-10s %7s %12s %12s %12s %12s %12s\n", "payload", "bytes", "enc orig", "enc fast", "enc buffer", "dec orig", "dec fast");
+	for (const size_t size : {fast_base64::ADDRESS_SIZE, (size_t)110, (size_t)352}) {
+		std::vector<std::string> inputs(64);
+		for (auto& input : inputs) {
+			input.resize(size);
+			for (auto& c : input) {
+				c = (char)rng();
+			}
+		}
+		std::vector<std::string> texts;
+		for (const auto& input : inputs) {
+			texts.push_back(base64::to_base64(input));
+		}
+
+		u64 sink = 0;
+		char buffer[1024];
+		u8 bytes[1024];
+		const auto enc_orig = ns_per_call(rounds, [&](u32 i) { sink += base64::to_base64(inputs[i % 64]).size(); });
+		const auto enc_fast = ns_per_call(rounds, [&](u32 i) { sink += fast_base64::to_base64(inputs[i % 64]).size(); });
+		const auto enc_buffer = size == fast_base64::ADDRESS_SIZE
+			? ns_per_call(rounds, [&](u32 i) { fast_base64::encode_address((const u8*)inputs[i % 64].data(), buffer); sink += buffer[3]; })
+			: ns_per_call(rounds, [&](u32 i) { sink += fast_base64::encode(inputs[i % 64].data(), size, buffer); });
+		const auto dec_orig = ns_per_call(rounds, [&](u32 i) { sink += base64::from_base64(texts[i % 64]).size(); });
+		const auto dec_fast = size == fast_base64::ADDRESS_SIZE
+			? ns_per_call(rounds, [&](u32 i) { sink += fast_base64::decode_address(texts[i % 64], bytes) + bytes[5]; })
+			: ns_per_call(rounds, [&](u32 i) { sink += fast_base64::decode(texts[i % 64], bytes, sizeof(bytes)); });
+		printf("%-10s %7zu %9.1f ns %9.1f ns %9.1f ns %9.1f ns %9.1f ns (%llu)\n", size == fast_base64::ADDRESS_SIZE ? "peer ID" : "ad",
+			size, enc_orig, enc_fast, enc_buffer, dec_orig, dec_fast, sink);
+	}
+}
+
+int main(int argc, char** argv) {
+	const u32 iterations = argc > 1 ? (u32)std::stoul(argv[1]) : 200'000;
+#ifdef CROWNLINK_BASE64_SSSE3
+	printf("fast_base64: SSSE3\n");
+#else
+	printf("fast_base64: scalar\n");
+#endif
+	const bool ok = check(iterations);
+	throughput(2'000'000);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// Checks and times the packet compressor: round-trips captured and synthetic Storm packets, prints
+// how much each one shrinks, checks that a too small output buffer is refused, fuzzes the decoder
+// with mutated and random input (build with CROWNLINK_SANITIZE to catch bad reads and writes) and
+// measures compression and decompression throughput.
+#include "../SNP/Compression.h"
+
+#include <random>
+#include <cctype>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+	const char* name;
+	std::string bytes;
+};
+
+static std::string from_hex(const char* text) {
+	std::string result;
+	for (const char* c = text; c[0] && c[1]; c++) {
+		if (isxdigit(c[0]) && isxdigit(c[1])) {
+			result.push_back((char)std::stoi(std::string{c, 2}, nullptr, 16));
+			c++;
+		}
+	}
+	return result;
+}
+
+static std::vector<Sample> samples() {
+	std::mt19937 rng{30};
+	std::string random(200, '\0');
+	for (auto& c : random) {
+		c = (char)rng();
+	}
+	std::string padded = from_hex("58 b0 d4 00 02 00 03 00 00 08 00 00 01 00 00 00");
+	padded.resize(212, '\0');
+	return {
+		{"keepalive", from_hex("74 30 0d 00 23 00 23 00 02 00 01 00 05")},
+		{"player name", from_hex("6c 78 14 00 02 00 02 00 00 07 ff 00 4a 65 73 73 65 00 00 00")},
+		{"map data", from_hex(
+			"58 b0 4e 00 02 00 03 00 00 08 00 00 01 00 00 00 08 00 00 00 16 00 00 00 04 00 00 00 05 00 00 00"
+			"4a 65 73 73 65 00 2c 34 34 2c 2c 33 2c 2c 31 65 2c 2c 31 2c 63 62 32 65 64 61 61 62 2c 31 2c 2c"
+			"4a 65 73 73 65 0d 41 78 69 6f 6d 0d 00 00")},
+		{"turn", from_hex(
+			"91 2c 34 00 41 01 40 01 02 00 01 00 37 01 64 95 00 70 22 63 02 02 00 00 88 0e 00 00 00 00 00 63"
+			"02 02 00 00 88 0e 3e 07 ff 06 02 04 3e 06 ff 06 02 04 00 00")},
+		{"zero padded", padded},
+		{"random", random},
+	};
+}
+
+static bool round_trip(const std::string& input, size_t* compressed_size = nullptr) {
+	char compressed[2048];
+	char decompressed[1024];
+	const auto size = compression::compress(input.data(), input.size(), compressed, sizeof(compressed));
+	if (compressed_size) {
+		*compressed_size = size;
+	}
+	if (!size) {
+		return false;
+	}
+	const auto restored = compression::decompress(compressed, size, decompressed, sizeof(decompressed));
+	return restored == input.size() && !memcmp(decompressed, input.data(), restored);
+}
+
+static bool check_samples(const std::vector<Sample>& samples) {
+	bool ok = true;
+	for (const auto& sample : samples) {
+		size_t compressed_size = 0;
+		const bool sample_ok = round_trip(sample.bytes, &compressed_size);
+		printf("%-12s %s  %3zu -> %3zu bytes (%.0f%%)\n", sample.name, sample_ok ? "ok  " : "FAIL",
+			sample.bytes.size(), compressed_size, 100.0 * compressed_size / sample.bytes.size());
+		ok &= sample_ok;
+
+		// The sender falls back to the raw packet when the result does not fit
+		char small[8];
+		if (sample.bytes.size() > 32 && compression::compress(sample.bytes.data(), sample.bytes.size(), small, sizeof(small))) {
+			printf("  compressed into a buffer that is too small\n");
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Any input must either round-trip or decode to at most capacity bytes, never past the buffer
+static bool fuzz(const std::vector<Sample>& samples, u32 iterations) {
+	std::mt19937 rng{1030};
+	u64 decoded = 0;
+	for (u32 i = 0; i < iterations; i++) {
+		std::string input = samples[rng() % samples.size()].bytes;
+		const auto mutations = 1 + rng() % 4;
+		for (u32 m = 0; m < mutations; m++) {
+			input[rng() % input.size()] = (char)rng();
+		}
+		input.resize(1 + rng() % std::min<size_t>(1024, input.size() + 64), '\0');
+		if (!round_trip(input)) {
+			printf("fuzz: %zu byte input did not round trip\n", input.size());
+			return false;
+		}
+
+		char compressed[2048];
+		auto size = compression::compress(input.data(), input.size(), compressed, sizeof(compressed));
+		for (u32 m = 0; m < mutations && size; m++) {
+			compressed[rng() % size] = (char)rng();
+		}
+		if (rng() % 4 == 0) {
+			size = rng() % sizeof(compressed);
+			for (size_t b = 0; b < size; b++) {
+				compressed[b] = (char)rng();
+			}
+		}
+		const auto capacity = (u32)(1 + rng() % 1024);
+		const auto out = std::make_unique<char[]>(capacity);
+		const auto produced = compression::decompress(compressed, size, out.get(), capacity);
+		if (produced > capacity) {
+			printf("fuzz: decoded %zu bytes into %u\n", produced, capacity);
+			return false;
+		}
+		decoded += produced != 0;
+	}
+	printf("fuzz: %u inputs round-tripped, %llu corrupted streams still decoded\n", iterations, decoded);
+	return true;
+}
+
+static void throughput(const std::vector<Sample>& samples, u32 rounds) {
+	char compressed[2048];
+	char decompressed[1024];
+	u64 bytes = 0;
+	u64 checksum = 0;
+	auto start = Clock::now();
+	for (u32 round = 0; round < rounds; round++) {
+		for (const auto& sample : samples) {
+			checksum += compression::compress(sample.bytes.data(), sample.bytes.size(), compressed, sizeof(compressed));
+			bytes += sample.bytes.size();
+		}
+	}
+	const auto compress_elapsed = std::chrono::duration<f64>(Clock::now() - start).count();
+
+	std::vector<std::string> streams;
+	for (const auto& sample : samples) {
+		const auto size = compression::compress(sample.bytes.data(), sample.bytes.size(), compressed, sizeof(compressed));
+		streams.emplace_back(compressed, size);
+	}
+	start = Clock::now();
+	for (u32 round = 0; round < rounds; round++) {
+		for (const auto& stream : streams) {
+			checksum += compression::decompress(stream.data(), stream.size(), decompressed, sizeof(decompressed));
+		}
+	}
+	const auto decompress_elapsed = std::chrono::duration<f64>(Clock::now() - start).count();
+
+	const auto packets = (f64)rounds * samples.size();
+	printf("compress:   %.0f packets in %.3f s, %.0f ns/packet, %.0f MB/s\n",
+		packets, compress_elapsed, compress_elapsed * 1e9 / packets, bytes / compress_elapsed / 1e6);
+	printf("decompress: %.0f packets in %.3f s, %.0f ns/packet, %.0f MB/s (%llu)\n",
+		packets, decompress_elapsed, decompress_elapsed * 1e9 / packets, bytes / decompress_elapsed / 1e6, checksum);
+}
+
+int main(int argc, char** argv) {
+	const u32 iterations = argc > 1 ? (u32)std::stoul(argv[1]) : 200'000;
+	const auto packets = samples();
+
+	const bool samples_ok = check_samples(packets);
+	const bool fuzz_ok = fuzz(packets, iterations);
+	throughput(packets, 100'000);
+	return samples_ok && fuzz_ok ? 0 : 1;
+}
@@ -0,0 +1,642 @@
+// Headless loopback benchmark: one local signaling server and N CrownLink peers (one process each,
+// since the SNP keeps its state in globals), driven through the SPI table exactly like Storm does.
+// Reports end-to-end turn latency percentiles, throughput and CPU per packet for each turn rate.
+#include "CrownLink.h"
+#include "SNPModule.h"
+#include "Config.h"
+#include "LocalSignalingServer.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_set>
+
+using Clock = std::chrono::steady_clock;
+
+using SpiLockGameList = BOOL(__stdcall*)(int, int, game**);
+using SpiUnlockGameList = BOOL(__stdcall*)(game*, DWORD*);
+using SpiStartAdvertisingLadderGame = BOOL(__stdcall*)(char*, char*, char*, DWORD, DWORD, DWORD, int, int, void*, DWORD);
+
+constexpr u32 HELLO_PHASE = 0xffffffff;
+constexpr const char* BENCH_GAME_NAME = "CrownLinkBench";
+constexpr u32 BULK_PACKET_SIZE = 500;
+
+struct BenchOptions {
+	u32 peers = 4;
+	std::vector<u32> turn_rates{8, 16, 24};
+	u32 seconds = 10;
+	u32 payload_size = 64;
+	u32 connect_timeout = 30;
+	f64 max_p99_ms = 0;
+	f64 max_loss = 0;
+	ImpairmentConfig impairment;
+	FecConfig fec;
+	CompressionConfig compression;
+	SchedulerConfig scheduler;
+	MultipathConfig multipath;
+	ReorderConfig reorder;
+	JuiceConcurrency juice_concurrency = JuiceConcurrency::Thread;
+	u16 mux_port = 47000; // peer N uses this + N, each process has its own mux
+	u32 bulk_kbps = 0;
+	u32 block_direct = 0; // peers that cannot reach the first one directly, every peer then talks to every other
+};
+
+#pragma pack(push, 1)
+// Mirrors Storm's HEADER so the traffic looks like turn packets to anything that inspects it
+struct BenchPacket {
+	u16 checksum;
+	u16 bytes;
+	u16 sequence;
+	u16 acksequence;
+	u8 type;
+	u8 subtype;
+	u8 playerid;
+	u8 flags;
+	s64 sent_ns;
+	u32 phase;
+};
+#pragma pack(pop)
+
+struct PhaseResult {
+	u64 sent = 0;
+	u64 received = 0;
+	u64 bytes_received = 0;
+	u64 bulk_bytes_received = 0;
+	u64 cpu_us = 0;
+	u64 context_switches = 0;
+	u64 threads = 0;
+	u64 receive_events = 0;
+	u64 out_of_order = 0; // arrived after a higher sequence number from the same peer and type
+	// CrownLink's own receive path, see PipelineMetrics
+	LatencyHistogram::Counts processing{};
+	LatencyHistogram::Counts queued{};
+	std::vector<u32> latencies_us;
+};
+
+static s64 now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static u64 cpu_time_us() {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return (u64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Every switch is a thread waking up or being preempted, which is what the per agent threads cost
+static u64 context_switches() {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return (u64)(usage.ru_nvcsw + usage.ru_nivcsw);
+}
+
+static u64 thread_count() {
+	std::error_code error;
+	const std::filesystem::directory_iterator tasks{"/proc/self/task", error};
+	return error ? 0 : (u64)std::distance(tasks, std::filesystem::directory_iterator{});
+}
+
+static bool write_all(int fd, const void* data, size_t size) {
+	auto bytes = (const char*)data;
+	while (size) {
+		const auto written = write(fd, bytes, size);
+		if (written <= 0) return false;
+		bytes += written;
+		size -= written;
+	}
+	return true;
+}
+
+static bool read_all(int fd, void* data, size_t size) {
+	auto bytes = (char*)data;
+	while (size) {
+		const auto received = read(fd, bytes, size);
+		if (received <= 0) return false;
+		bytes += received;
+		size -= received;
+	}
+	return true;
+}
+
+class BenchPeer {
+public:
+	BenchPeer(u32 index, const BenchOptions& options) : m_index{index}, m_options{options}, m_phases(options.turn_rates.size()) {}
+
+	// Returns false if the peer could not reach everybody it should before the timeout
+	bool connect() {
+		client_info client{.size = sizeof(client_info), .program_id = 'BNCH', .version_id = 1};
+		user_info user{.size = sizeof(user_info)};
+		battle_info battle{.size = sizeof(battle_info)};
+		module_info module{.size = sizeof(module_info)};
+
+		g_crown_link = std::make_unique<CrownLink>();
+		snp::g_spi_functions.spiInitialize(&client, &user, &battle, &module, &m_receive_event);
+		spdlog::set_level(spdlog::level::warn);
+		m_receiver = std::jthread{[this](std::stop_token stop) { receive_loop(stop); }};
+
+		const auto deadline = Clock::now() + std::chrono::seconds{m_options.connect_timeout};
+		while (g_crown_link->signaling_socket().state() != SocketState::Ready) {
+			if (Clock::now() > deadline) return false;
+			std::this_thread::sleep_for(10ms);
+		}
+
+		if (is_host() || is_mesh()) {
+			// In a mesh everybody advertises, that is how the peers find each other
+			char game_name[64];
+			snprintf(game_name, sizeof(game_name), "%s %u", BENCH_GAME_NAME, m_index);
+			char password[] = "";
+			char stat_string[] = ",33,,3,,1e,,1,cb2edaab,5,,Bench\rLoopback\r";
+			char user_data[32]{};
+			auto start_advertising = (SpiStartAdvertisingLadderGame)snp::g_spi_functions.spiStartAdvertisingLadderGame;
+			start_advertising(game_name, password, stat_string, 0, 0, 0, 0, 0, user_data, sizeof(user_data));
+		}
+
+		while (true) {
+			if (Clock::now() > deadline) return false;
+			const size_t expected = is_host() || is_mesh() ? m_options.peers - 1 : 1;
+			if ((!is_host() || is_mesh()) && peers().size() < expected) {
+				find_peers();
+			}
+			for (const auto& peer : peers()) {
+				send_to(peer, StormType::System, HELLO_PHASE);
+			}
+			if (peers().size() == expected && hellos_received() >= (is_mesh() ? expected : 1)) {
+				return true;
+			}
+			std::this_thread::sleep_for(100ms);
+		}
+	}
+
+	void run(s64 start_ns) {
+		const auto phase_duration = std::chrono::seconds{m_options.seconds};
+		const auto start = Clock::time_point{std::chrono::nanoseconds{start_ns}};
+		const auto targets = peers();
+
+		for (u32 phase = 0; phase < m_options.turn_rates.size(); phase++) {
+			const auto rate = m_options.turn_rates[phase];
+			const auto phase_start = start + phase * (phase_duration + 1s);
+			const auto turns = (u64)m_options.seconds * rate;
+
+			std::this_thread::sleep_until(phase_start);
+			const auto cpu_start = cpu_time_us();
+			const auto switches_start = context_switches();
+			const auto events_start = g_crown_link->receive_queue().wakeups();
+			auto& metrics = PipelineMetrics::instance();
+			const auto processing_start = metrics.processing.snapshot();
+			const auto queued_start = metrics.queued.snapshot();
+			std::jthread bulk;
+			if (m_options.bulk_kbps) {
+				bulk = std::jthread{[&, phase](std::stop_token stop) { send_bulk(stop, targets, phase); }};
+			}
+			for (u64 turn = 0; turn < turns; turn++) {
+				std::this_thread::sleep_until(phase_start + std::chrono::nanoseconds{1000000000ll * turn / rate});
+				for (const auto& peer : targets) {
+					send_to(peer, StormType::Turn, phase);
+					m_phases[phase].sent++;
+				}
+			}
+			if (bulk.joinable()) {
+				bulk.request_stop();
+				bulk.join();
+			}
+			std::this_thread::sleep_until(phase_start + phase_duration + 1s);
+			m_phases[phase].cpu_us = cpu_time_us() - cpu_start;
+			m_phases[phase].context_switches = context_switches() - switches_start;
+			m_phases[phase].threads = thread_count();
+			m_phases[phase].receive_events = g_crown_link->receive_queue().wakeups() - events_start;
+			m_phases[phase].processing = metrics.processing.snapshot();
+			m_phases[phase].queued = metrics.queued.snapshot();
+			for (u32 i = 0; i < LatencyHistogram::BUCKETS; i++) {
+				m_phases[phase].processing[i] -= processing_start[i];
+				m_phases[phase].queued[i] -= queued_start[i];
+			}
+		}
+
+		m_receiver.request_stop();
+		m_receiver.join();
+		// ICE failed for these, so whatever arrived from them went through another peer
+		for (const auto& peer : targets) {
+			if (g_crown_link->juice_manager().agent_state(peer) == JUICE_STATE_FAILED) {
+				m_forwarded_peers++;
+				m_forwarded_turns += m_turns_from[peer];
+			}
+		}
+		snp::g_spi_functions.spiDestroy();
+	}
+
+	void write_results(int fd) {
+		for (auto& phase : m_phases) {
+			const u64 header[] = {phase.sent, phase.received, phase.bytes_received, phase.bulk_bytes_received, phase.cpu_us,
+				phase.context_switches, phase.threads, phase.receive_events, phase.out_of_order, phase.latencies_us.size()};
+			write_all(fd, header, sizeof(header));
+			write_all(fd, phase.processing.data(), sizeof(phase.processing));
+			write_all(fd, phase.queued.data(), sizeof(phase.queued));
+			write_all(fd, phase.latencies_us.data(), phase.latencies_us.size() * sizeof(u32));
+		}
+		const u64 forwarding[] = {m_forwarded_peers, m_forwarded_turns};
+		write_all(fd, forwarding, sizeof(forwarding));
+	}
+
+private:
+	bool is_host() const { return m_index == 0; }
+	bool is_mesh() const { return m_options.block_direct > 0; }
+
+	std::vector<NetAddress> peers() {
+		std::lock_guard lock{m_mutex};
+		return m_peers;
+	}
+
+	size_t hellos_received() {
+		std::lock_guard lock{m_mutex};
+		return m_hello_senders.size();
+	}
+
+	void find_peers() {
+		auto unlock_game_list = (SpiUnlockGameList)snp::g_spi_functions.spiUnlockGameList;
+		auto lock_game_list = (SpiLockGameList)snp::g_spi_functions.spiLockGameList;
+		unlock_game_list(nullptr, nullptr);
+
+		game* games = nullptr;
+		lock_game_list(0, 0, &games);
+		for (auto current = games; current; current = current->pNext) {
+			if (strstr(current->game_name, BENCH_GAME_NAME)) {
+				std::lock_guard lock{m_mutex};
+				if (std::find(m_peers.begin(), m_peers.end(), current->host) == m_peers.end()) {
+					m_peers.push_back(current->host);
+				}
+				if (!is_mesh()) {
+					break;
+				}
+			}
+		}
+	}
+
+	// Lobby-style bulk traffic competing with the turns, like a map transfer
+	void send_bulk(std::stop_token stop, const std::vector<NetAddress>& targets, u32 phase) {
+		const auto interval = std::chrono::microseconds{(u64)BULK_PACKET_SIZE * 8000 * targets.size() / m_options.bulk_kbps};
+		for (auto next = Clock::now(); !stop.stop_requested(); next += interval) {
+			std::this_thread::sleep_until(next);
+			for (const auto& peer : targets) {
+				send_to(peer, StormType::Message, phase, BULK_PACKET_SIZE);
+			}
+		}
+	}
+
+	void send_to(const NetAddress& peer, StormType type, u32 phase, u32 payload_size = 0) {
+		char buffer[snp::MAX_PACKET_SIZE]{};
+		const auto size = std::clamp<u32>(payload_size ? payload_size : m_options.payload_size, sizeof(BenchPacket), sizeof(buffer));
+		auto& packet = *(BenchPacket*)buffer;
+		packet.bytes = (u16)size;
+		packet.sequence = next_sequence(peer, type);
+		packet.type = (u8)type;
+		packet.playerid = (u8)m_index;
+		packet.sent_ns = now_ns();
+		packet.phase = phase;
+
+		NetAddress target = peer;
+		NetAddress* address_list[] = {&target};
+		snp::g_spi_functions.spiSend(1, address_list, buffer, size);
+	}
+
+	// Like Storm, every destination and type has its own sequence numbers
+	u16 next_sequence(const NetAddress& peer, StormType type) {
+		std::lock_guard lock{m_mutex};
+		return m_sequences[peer][(size_t)type]++;
+	}
+
+	bool is_out_of_order(const NetAddress& sender, StormType type, u16 sequence) {
+		auto& highest = m_highest_received[sender][(size_t)type];
+		const bool out_of_order = highest && (s16)(u16)(sequence - *highest) < 0;
+		if (!out_of_order) {
+			highest = sequence;
+		}
+		return out_of_order;
+	}
+
+	void receive_loop(std::stop_token stop) {
+		while (!stop.stop_requested()) {
+			m_receive_event.wait_for(100ms);
+
+			NetAddress* sender = nullptr;
+			char* data = nullptr;
+			DWORD size = 0;
+			while (snp::g_spi_functions.spiReceive(&sender, &data, &size)) {
+				handle_packet(*sender, data, size);
+				snp::g_spi_functions.spiFree(sender, data, size);
+			}
+		}
+	}
+
+	void handle_packet(const NetAddress& sender, const char* data, u32 size) {
+		if (size < sizeof(BenchPacket)) {
+			return;
+		}
+		const auto& packet = *(const BenchPacket*)data;
+		if (packet.phase == HELLO_PHASE) {
+			std::lock_guard lock{m_mutex};
+			m_hello_senders.insert(sender);
+			if (std::find(m_peers.begin(), m_peers.end(), sender) == m_peers.end()) {
+				m_peers.push_back(sender);
+			}
+			return;
+		}
+		if (packet.phase >= m_phases.size()) {
+			return;
+		}
+		auto& phase = m_phases[packet.phase];
+		if (is_out_of_order(sender, (StormType)packet.type, packet.sequence)) {
+			phase.out_of_order++;
+		}
+		if (packet.type == (u8)StormType::Message) {
+			phase.bulk_bytes_received += size;
+			return;
+		}
+		phase.received++;
+		phase.bytes_received += size;
+		m_turns_from[sender]++;
+		phase.latencies_us.push_back((u32)std::max<s64>(0, (now_ns() - packet.sent_ns) / 1000));
+	}
+
+private:
+	u32 m_index;
+	const BenchOptions& m_options;
+	platform::Event m_receive_event;
+	std::jthread m_receiver;
+	std::mutex m_mutex;
+	std::vector<NetAddress> m_peers;
+	std::unordered_set<NetAddress> m_hello_senders;
+	std::vector<PhaseResult> m_phases;
+	std::unordered_map<NetAddress, std::array<u16, 3>> m_sequences;
+	std::unordered_map<NetAddress, std::array<std::optional<u16>, 3>> m_highest_received; // receiver thread only
+	std::unordered_map<NetAddress, u64> m_turns_from; // receiver thread only
+	u64 m_forwarded_peers = 0;
+	u64 m_forwarded_turns = 0;
+};
+
+static int run_child(u32 index, const BenchOptions& options, int control_fd, int result_fd) {
+	SnpConfig::instance().mux_port = (u16)(options.mux_port + index);
+	BenchPeer peer{index, options};
+	const u8 ready = peer.connect() ? 1 : 0;
+	write_all(result_fd, &ready, sizeof(ready));
+	if (!ready) {
+		return 1;
+	}
+
+	s64 start_ns = 0;
+	if (!read_all(control_fd, &start_ns, sizeof(start_ns))) {
+		return 1;
+	}
+	peer.run(start_ns);
+	peer.write_results(result_fd);
+	return 0;
+}
+
+static f64 percentile(const std::vector<u32>& sorted, f64 fraction) {
+	if (sorted.empty()) return 0;
+	return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))] / 1000.0;
+}
+
+static bool parse_options(int argc, char** argv, BenchOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value) {
+			return false;
+		}
+		if (arg == "--peers") {
+			options.peers = std::max(2, std::stoi(value));
+		} else if (arg == "--tps") {
+			options.turn_rates.clear();
+			std::stringstream ss{value};
+			for (std::string rate; std::getline(ss, rate, ',');) {
+				options.turn_rates.push_back(std::max(1, std::stoi(rate)));
+			}
+		} else if (arg == "--seconds") {
+			options.seconds = std::max(1, std::stoi(value));
+		} else if (arg == "--payload") {
+			options.payload_size = std::stoi(value);
+		} else if (arg == "--connect-timeout") {
+			options.connect_timeout = std::stoi(value);
+		} else if (arg == "--max-p99-ms") {
+			options.max_p99_ms = std::stod(value);
+		} else if (arg == "--max-loss") {
+			options.max_loss = std::stod(value);
+		} else if (arg == "--fec") {
+			options.fec.enabled = true;
+			options.fec.group_size = std::stoi(value);
+		} else if (arg == "--pace-kbps") {
+			options.scheduler.enabled = true;
+			options.scheduler.bulk_kbps = std::stoi(value);
+		} else if (arg == "--multipath") {
+			options.multipath.enabled = true;
+			options.multipath.mode = Json(value).get<MultipathMode>();
+		} else if (arg == "--juice") {
+			options.juice_concurrency = Json(value).get<JuiceConcurrency>();
+		} else if (arg == "--mux-port") {
+			options.mux_port = (u16)std::stoi(value);
+		} else if (arg == "--block-direct") {
+			options.block_direct = std::stoi(value);
+		} else if (arg == "--bulk-kbps") {
+			options.bulk_kbps = std::stoi(value);
+		} else if (arg == "--compress") {
+			options.compression.enabled = true;
+			options.compression.min_size = std::stoi(value);
+		} else if (arg == "--delay-ms") {
+			options.impairment.delay_ms = std::stoi(value);
+		} else if (arg == "--jitter-ms") {
+			options.impairment.jitter_ms = std::stoi(value);
+		} else if (arg == "--distribution") {
+			options.impairment.distribution = Json(value).get<DelayDistribution>();
+		} else if (arg == "--loss") {
+			options.impairment.loss = std::stod(value);
+		} else if (arg == "--duplicate") {
+			options.impairment.duplicate = std::stod(value);
+		} else if (arg == "--reorder") {
+			options.impairment.reorder = std::stod(value);
+		} else if (arg == "--reorder-hold-ms") {
+			options.reorder.enabled = true;
+			options.reorder.hold_ms = std::stoi(value);
+		} else if (arg == "--bandwidth-kbps") {
+			options.impairment.bandwidth_kbps = std::stoi(value);
+		} else {
+			return false;
+		}
+		i++;
+	}
+
+	// Every blocked pair needs a third peer to forward for it
+	if (options.block_direct && options.peers < options.block_direct + 2) {
+		return false;
+	}
+
+	auto& impairment = options.impairment;
+	impairment.enabled = impairment.delay_ms || impairment.jitter_ms || impairment.loss > 0 || impairment.duplicate > 0
+		|| impairment.reorder > 0 || impairment.bandwidth_kbps;
+	return !options.turn_rates.empty();
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	if (!parse_options(argc, argv, options)) {
+		printf("usage: %s [--peers N] [--tps 8,16,24] [--seconds S] [--payload BYTES]\n"
+			"       [--connect-timeout S] [--max-p99-ms MS] [--max-loss FRACTION]\n"
+			"       [--delay-ms MS] [--jitter-ms MS] [--distribution uniform|normal|pareto]\n"
+			"       [--loss P] [--duplicate P] [--reorder P] [--bandwidth-kbps KBPS]\n"
+			"       [--fec GROUP_SIZE] [--compress MIN_SIZE] [--bulk-kbps KBPS] [--pace-kbps KBPS]\n"
+			"       [--multipath fastest|both] [--juice thread|poll|mux] [--mux-port PORT]\n"
+			"       [--reorder-hold-ms MS] [--block-direct PEERS]\n", argv[0]);
+		return 2;
+	}
+
+	LocalSignalingServer server;
+	server.block_direct(options.block_direct);
+
+	// Children inherit the loaded config, so nobody else races on CrownLink.json
+	auto& config = SnpConfig::instance();
+	config.server = "127.0.0.1";
+	config.port = server.port();
+	config.stun_server = "";
+	config.impairment = options.impairment;
+	config.fec = options.fec;
+	config.compression = options.compression;
+	config.scheduler = options.scheduler;
+	config.multipath = options.multipath;
+	config.reorder = options.reorder;
+	config.juice_concurrency = options.juice_concurrency;
+	config.forwarding.enabled = options.block_direct > 0;
+
+	struct Child {
+		pid_t pid;
+		int control_fd;
+		int result_fd;
+	};
+	std::vector<Child> children;
+	for (u32 i = 0; i < options.peers; i++) {
+		int control[2];
+		int result[2];
+		if (pipe(control) != 0 || pipe(result) != 0) {
+			perror("pipe");
+			return 1;
+		}
+		const auto pid = fork();
+		if (pid == 0) {
+			close(control[1]);
+			close(result[0]);
+			_exit(run_child(i, options, control[0], result[1]));
+		}
+		close(control[0]);
+		close(result[1]);
+		children.push_back(Child{pid, control[1], result[0]});
+	}
+	server.start();
+
+	bool all_ready = true;
+	for (auto& child : children) {
+		u8 ready = 0;
+		all_ready &= read_all(child.result_fd, &ready, sizeof(ready)) && ready;
+	}
+	if (!all_ready) {
+		printf("not every peer connected within %u s\n", options.connect_timeout);
+		for (auto& child : children) {
+			kill(child.pid, SIGKILL);
+			waitpid(child.pid, nullptr, 0);
+		}
+		return 1;
+	}
+
+	const s64 start_ns = now_ns() + 500'000'000;
+	for (auto& child : children) {
+		write_all(child.control_fd, &start_ns, sizeof(start_ns));
+	}
+
+	std::vector<PhaseResult> totals(options.turn_rates.size());
+	u64 forwarded_peers = 0;
+	u64 forwarded_turns = 0;
+	for (auto& child : children) {
+		for (auto& total : totals) {
+			u64 header[10]{};
+			if (!read_all(child.result_fd, header, sizeof(header))) {
+				printf("peer %d exited without results\n", child.pid);
+				return 1;
+			}
+			LatencyHistogram::Counts processing{};
+			LatencyHistogram::Counts queued{};
+			read_all(child.result_fd, processing.data(), sizeof(processing));
+			read_all(child.result_fd, queued.data(), sizeof(queued));
+			for (u32 i = 0; i < LatencyHistogram::BUCKETS; i++) {
+				total.processing[i] += processing[i];
+				total.queued[i] += queued[i];
+			}
+			std::vector<u32> latencies(header[9]);
+			read_all(child.result_fd, latencies.data(), latencies.size() * sizeof(u32));
+			total.sent += header[0];
+			total.received += header[1];
+			total.bytes_received += header[2];
+			total.bulk_bytes_received += header[3];
+			total.cpu_us += header[4];
+			total.context_switches += header[5];
+			total.threads += header[6];
+			total.receive_events += header[7];
+			total.out_of_order += header[8];
+			total.latencies_us.insert(total.latencies_us.end(), latencies.begin(), latencies.end());
+		}
+		u64 forwarding[2]{};
+		read_all(child.result_fd, forwarding, sizeof(forwarding));
+		forwarded_peers += forwarding[0];
+		forwarded_turns += forwarding[1];
+		waitpid(child.pid, nullptr, 0);
+	}
+	server.stop();
+
+	bool passed = true;
+	printf("%u peers, %u s per rate, %u byte turns\n", options.peers, options.seconds, options.payload_size);
+	if (options.impairment.enabled) {
+		const auto& impairment = options.impairment;
+		printf("impairment: delay %u ms, jitter %u ms (%s), loss %.3f, duplicate %.3f, reorder %.3f, bandwidth %u kbps\n",
+			impairment.delay_ms, impairment.jitter_ms, to_string(impairment.distribution).c_str(),
+			impairment.loss, impairment.duplicate, impairment.reorder, impairment.bandwidth_kbps);
+	}
+	if (options.multipath.enabled) {
+		printf("multipath: %s, impairment applies to the direct path only\n", to_string(options.multipath.mode).c_str());
+	}
+	const char* juice_layouts[] = {"a socket and thread per agent", "a socket per agent, one poll thread", "one socket and thread"};
+	printf("juice: %s, %s\n", to_string(options.juice_concurrency).c_str(), juice_layouts[(size_t)options.juice_concurrency]);
+	if (options.bulk_kbps) {
+		printf("bulk: %u kbps per peer, %s\n", options.bulk_kbps,
+			options.scheduler.enabled ? ("paced from " + std::to_string(options.scheduler.bulk_kbps) + " kbps").c_str() : "not paced");
+	}
+	printf("%5s %8s %8s %7s %8s %8s %8s %8s %9s %9s %11s %10s %9s %8s %9s %10s %10s %6s\n",
+		"tps", "sent", "recv", "loss%", "p50ms", "p90ms", "p99ms", "maxms", "pkt/s", "kB/s", "cpu_us/pkt", "bulk kB/s",
+		"csw/turn", "threads", "events/s", "proc p99us", "queue p99us", "ooo%");
+	for (size_t i = 0; i < totals.size(); i++) {
+		auto& total = totals[i];
+		std::sort(total.latencies_us.begin(), total.latencies_us.end());
+		const auto loss = total.sent ? 1.0 - (f64)total.received / total.sent : 0.0;
+		const auto p99 = percentile(total.latencies_us, 0.99);
+		const auto packets = total.sent + total.received;
+		printf("%5u %8llu %8llu %7.2f %8.3f %8.3f %8.3f %8.3f %9.1f %9.1f %11.2f %10.1f %9.2f %8.1f %9.1f %10.1f %10.1f %6.2f\n",
+			options.turn_rates[i], total.sent, total.received, loss * 100,
+			percentile(total.latencies_us, 0.5), percentile(total.latencies_us, 0.9), p99,
+			total.latencies_us.empty() ? 0.0 : total.latencies_us.back() / 1000.0,
+			(f64)total.received / options.seconds, total.bytes_received / 1024.0 / options.seconds,
+			packets ? (f64)total.cpu_us / packets : 0.0, total.bulk_bytes_received / 1024.0 / options.seconds,
+			(f64)total.context_switches / ((u64)options.seconds * options.turn_rates[i] * options.peers),
+			(f64)total.threads / options.peers, (f64)total.receive_events / options.seconds,
+			LatencyHistogram::percentile_us(total.processing, 0.99), LatencyHistogram::percentile_us(total.queued, 0.99),
+			total.received ? 100.0 * total.out_of_order / total.received : 0.0);
+
+		if (options.max_p99_ms > 0 && p99 > options.max_p99_ms) passed = false;
+		if (options.max_loss > 0 && loss > options.max_loss) passed = false;
+	}
+	if (options.block_direct) {
+		// Both ends of a blocked pair count it
+		const bool forwarded = forwarded_peers >= 2ull * options.block_direct && forwarded_turns > 0;
+		printf("forwarding: %llu of %u blocked pairs without ICE, %llu turns received from them through a relay%s\n",
+			forwarded_peers / 2, options.block_direct, forwarded_turns, forwarded ? "" : ", FAILED");
+		passed &= forwarded;
+	}
+	return passed ? 0 : 1;
+}
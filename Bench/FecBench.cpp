@@ -0,0 +1,184 @@
+// Checks and times forward error correction: runs Storm-sized packets through FecEncoder, a lossy
+// link and FecDecoder, checks that every packet arrives intact and at most once, that a single loss
+// per group is always rebuilt and that the decoder's loss reports track the real loss. Then prints
+// residual loss and overhead at a few loss rates and the encode/decode throughput.
+#include "../SNP/Fec.h"
+
+#include <random>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+// Storm packet sizes seen in a game, mostly small turns with the odd big system packet
+static std::vector<std::string> make_packets(u32 count, u32 seed) {
+	std::mt19937 rng{seed};
+	std::vector<std::string> packets;
+	for (u32 i = 0; i < count; i++) {
+		const u32 size = rng() % 8 ? 13 + rng() % 40 : 13 + rng() % 500;
+		std::string packet(size, '\0');
+		for (auto& c : packet) {
+			c = (char)rng();
+		}
+		memcpy(packet.data(), &i, sizeof(i));
+		packets.push_back(std::move(packet));
+	}
+	return packets;
+}
+
+struct LinkResult {
+	u64 delivered = 0;
+	u64 corrupt = 0;
+	u64 repeated = 0;
+	u64 frames_lost = 0;
+	u64 payload_bytes = 0;
+	u64 frame_bytes = 0;
+	std::vector<f64> loss_reports;
+	FecStats stats;
+};
+
+// drop decides per frame whether the link loses it
+template <typename Drop>
+static LinkResult run_link(const std::vector<std::string>& packets, const FecConfig& config, Drop drop) {
+	LinkResult result;
+	FecEncoder encoder{config};
+	FecDecoder decoder;
+	std::vector<bool> seen(packets.size());
+	u64 frame_index = 0;
+
+	const FrameSink deliver = [&](const char* data, size_t size) {
+		u32 index;
+		memcpy(&index, data, sizeof(index));
+		if (index >= packets.size() || packets[index] != std::string_view{data, size}) {
+			result.corrupt++;
+			return;
+		}
+		result.repeated += seen[index];
+		seen[index] = true;
+		result.delivered++;
+	};
+	const FrameSink link = [&](const char* frame, size_t size) {
+		result.frame_bytes += size;
+		if (drop(frame_index++, frame, size)) {
+			result.frames_lost++;
+			return;
+		}
+		FrameHeader header;
+		memcpy(&header, frame, sizeof(header));
+		const auto payload = frame + sizeof(header);
+		const auto payload_size = size - sizeof(header);
+		if (header.type == FrameType::Data) {
+			decoder.on_data(header, payload, payload_size, deliver);
+			if (const auto loss = decoder.take_loss_report()) {
+				result.loss_reports.push_back(*loss);
+			}
+		} else if (header.type == FrameType::Parity) {
+			decoder.on_parity(header, payload, payload_size, deliver);
+		}
+	};
+
+	for (const auto& packet : packets) {
+		result.payload_bytes += packet.size();
+		encoder.encode(packet.data(), packet.size(), link);
+	}
+	result.stats = decoder.stats();
+	return result;
+}
+
+static FrameType frame_type(const char* frame) {
+	FrameHeader header;
+	memcpy(&header, frame, sizeof(header));
+	return header.type;
+}
+
+static bool check(const char* name, bool ok, const LinkResult& result) {
+	printf("%-22s %s  delivered %llu, recovered %llu, duplicates %llu, lost frames %llu, corrupt %llu, repeated %llu\n",
+		name, ok ? "ok  " : "FAIL", result.delivered, result.stats.recovered, result.stats.duplicates, result.frames_lost, result.corrupt, result.repeated);
+	return ok;
+}
+
+static bool check_links() {
+	const auto packets = make_packets(4096, 29);
+	const FecConfig protecting{.enabled = true, .group_size = 4, .enable_loss = 0};
+	bool ok = true;
+
+	{
+		auto result = run_link(packets, FecConfig{}, [](u64, const char*, size_t) { return false; });
+		ok &= check("clean, off", result.delivered == packets.size() && !result.corrupt && !result.repeated, result);
+	}
+	{
+		auto result = run_link(packets, protecting, [](u64, const char*, size_t) { return false; });
+		ok &= check("clean, protecting", result.delivered == packets.size() && !result.corrupt && !result.repeated && !result.stats.recovered, result);
+	}
+	{
+		// Every group loses its second Data frame, all of them must be rebuilt from parity
+		u64 data_frames = 0;
+		auto result = run_link(packets, protecting, [&](u64, const char* frame, size_t) {
+			return frame_type(frame) == FrameType::Data && data_frames++ % 4 == 1;
+		});
+		ok &= check("one loss per group", result.delivered == packets.size() && result.stats.recovered == packets.size() / 4
+			&& !result.corrupt && !result.repeated, result);
+	}
+	{
+		// Two losses in a group cannot be rebuilt, they are left to Storm and nothing wrong comes out
+		u64 data_frames = 0;
+		auto result = run_link(packets, protecting, [&](u64, const char* frame, size_t) {
+			return frame_type(frame) == FrameType::Data && data_frames++ % 4 < 2;
+		});
+		ok &= check("two losses per group", result.delivered == packets.size() / 2 && !result.stats.recovered
+			&& !result.corrupt && !result.repeated, result);
+	}
+	{
+		FecConfig duplicating = protecting;
+		duplicating.duplicate_below = 64;
+		auto result = run_link(packets, duplicating, [](u64, const char*, size_t) { return false; });
+		ok &= check("duplicate small", result.delivered == packets.size() && result.stats.duplicates > 0 && !result.repeated, result);
+	}
+	{
+		std::mt19937 rng{43};
+		auto result = run_link(packets, FecConfig{.enabled = true}, [&](u64, const char* frame, size_t) {
+			return frame_type(frame) == FrameType::Data && rng() % 10 == 0;
+		});
+		f64 average = 0;
+		for (auto loss : result.loss_reports) {
+			average += loss / result.loss_reports.size();
+		}
+		printf("loss reports: %zu, average %.1f%% for 10%% loss\n", result.loss_reports.size(), average * 100);
+		ok &= check("loss report", !result.loss_reports.empty() && average > 0.07 && average < 0.13 && !result.corrupt && !result.repeated, result);
+	}
+	return ok;
+}
+
+static void loss_sweep() {
+	const auto packets = make_packets(100'000, 30);
+	for (auto rate : {0.01, 0.05, 0.10}) {
+		for (u32 group_size : {0u, 8u, 4u, 2u}) {
+			std::mt19937 rng{(u32)(rate * 1000) + group_size};
+			std::bernoulli_distribution lost{rate};
+			const FecConfig config{.enabled = group_size != 0, .group_size = group_size, .enable_loss = 0};
+			auto result = run_link(packets, config, [&](u64, const char*, size_t) { return lost(rng); });
+			printf("loss %4.1f%%  %-9s residual %5.2f%%  overhead %5.1f%%\n", rate * 100,
+				group_size ? ("group " + std::to_string(group_size)).c_str() : "off",
+				100.0 * (packets.size() - result.delivered) / packets.size(),
+				100.0 * ((f64)result.frame_bytes / result.payload_bytes - 1));
+		}
+	}
+}
+
+static void throughput(u32 count) {
+	const auto packets = make_packets(count, 31);
+	const FecConfig config{.enabled = true, .group_size = 4, .enable_loss = 0};
+	const auto start = Clock::now();
+	const auto result = run_link(packets, config, [](u64 index, const char*, size_t) { return index % 5 == 1; });
+	const auto elapsed = std::chrono::duration<f64>(Clock::now() - start).count();
+	printf("throughput: %u packets in %.3f s, %.1f M packets/s, %.1f ns/packet encode + decode (%llu recovered)\n",
+		count, elapsed, count / elapsed / 1e6, elapsed * 1e9 / count, result.stats.recovered);
+}
+
+int main(int argc, char** argv) {
+	const u32 packets = argc > 1 ? (u32)std::stoul(argv[1]) : 1'000'000;
+
+	const bool ok = check_links();
+	loss_sweep();
+	throughput(packets);
+	return ok ? 0 : 1;
+}
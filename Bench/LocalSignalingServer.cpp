@@ -0,0 +1,208 @@
+#include "LocalSignalingServer.h"
+#include "Signaling.h"
+
+#include <poll.h>
+#include <netinet/in.h>
+#include <random>
+
+static const NetAddress g_server_id = [] {
+	NetAddress address;
+	memset(address.bytes, 255, sizeof(address.bytes));
+	return address;
+}();
+
+LocalSignalingServer::LocalSignalingServer(u16 port) {
+	m_listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listen_socket < 0) {
+		throw std::runtime_error{"could not create signaling server socket"};
+	}
+	const int reuse = 1;
+	setsockopt(m_listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	if (bind(m_listen_socket, (sockaddr*)&address, sizeof(address)) != 0 || listen(m_listen_socket, 64) != 0) {
+		platform::close_socket(m_listen_socket);
+		throw std::runtime_error{"could not bind signaling server to port " + std::to_string(port)};
+	}
+
+	socklen_t length = sizeof(address);
+	getsockname(m_listen_socket, (sockaddr*)&address, &length);
+	m_port = ntohs(address.sin_port);
+}
+
+LocalSignalingServer::~LocalSignalingServer() {
+	stop();
+	for (auto& connection : m_connections) {
+		platform::close_socket(connection.socket);
+	}
+	platform::close_socket(m_listen_socket);
+}
+
+void LocalSignalingServer::start() {
+	m_is_running = true;
+	m_thread = std::jthread{&LocalSignalingServer::run, this};
+}
+
+void LocalSignalingServer::stop() {
+	m_is_running = false;
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+void LocalSignalingServer::run() {
+	std::vector<pollfd> fds;
+	while (m_is_running) {
+		fds.clear();
+		fds.push_back(pollfd{m_listen_socket, POLLIN, 0});
+		for (const auto& connection : m_connections) {
+			fds.push_back(pollfd{connection.socket, POLLIN, 0});
+		}
+
+		if (poll(fds.data(), fds.size(), 100) <= 0) {
+			continue;
+		}
+
+		// Connections are only appended after this scan, so fds[i + 1] still matches m_connections[i]
+		std::vector<SOCKET> closed;
+		for (size_t i = 0; i < m_connections.size(); i++) {
+			if (fds[i + 1].revents && !receive_from(m_connections[i])) {
+				closed.push_back(m_connections[i].socket);
+			}
+		}
+		std::erase_if(m_connections, [&](const Connection& connection) {
+			if (std::find(closed.begin(), closed.end(), connection.socket) == closed.end()) {
+				return false;
+			}
+			platform::close_socket(connection.socket);
+			return true;
+		});
+
+		if (fds[0].revents & POLLIN) {
+			accept_connection();
+		}
+	}
+}
+
+void LocalSignalingServer::accept_connection() {
+	const auto socket = accept(m_listen_socket, nullptr, nullptr);
+	if (socket < 0) {
+		return;
+	}
+
+	static std::mt19937_64 rng{std::random_device{}()};
+	auto& connection = m_connections.emplace_back(Connection{.socket = socket, .order = m_next_order++});
+	for (auto& byte : connection.id.bytes) {
+		byte = (u8)rng();
+	}
+	send_to(connection, g_server_id, (s32)SignalMessageType::ServerSetID, connection.id.b64());
+}
+
+bool LocalSignalingServer::receive_from(Connection& connection) {
+	char buffer[4096];
+	const auto bytes = recv(connection.socket, buffer, sizeof(buffer), 0);
+	if (bytes <= 0) {
+		return false;
+	}
+	connection.buffer.append(buffer, bytes);
+
+	size_t pos_start = 0;
+	size_t pos_end = 0;
+	while ((pos_end = connection.buffer.find(Delimiter, pos_start)) != std::string::npos) {
+		const auto segment = std::string_view{connection.buffer}.substr(pos_start, pos_end - pos_start);
+		pos_start = pos_end + Delimiter.size();
+		if (segment.empty()) {
+			continue;
+		}
+		try {
+			handle_message(connection, Json::parse(segment));
+		} catch (const std::exception& e) {
+			spdlog::error("local signaling server could not handle \"{}\": {}", segment, e.what());
+		}
+	}
+	connection.buffer.erase(0, pos_start);
+	return true;
+}
+
+void LocalSignalingServer::handle_message(Connection& connection, const Json& json) {
+	const auto peer = NetAddress{base64::from_base64(json.at("peer_id").get<std::string>())};
+	const auto message_type = json.at("message_type").get<s32>();
+	const auto data = json.at("data").get<std::string>();
+
+	switch (SignalMessageType{message_type}) {
+		case SignalMessageType::StartAdvertising: {
+			connection.advertising = true;
+		} break;
+		case SignalMessageType::StopAdvertising: {
+			connection.advertising = false;
+		} break;
+		case SignalMessageType::RequestAdvertisers: {
+			std::string advertisers;
+			for (const auto& other : m_connections) {
+				if (other.advertising && other.id != connection.id) {
+					advertisers += other.id.b64();
+				}
+			}
+			if (!advertisers.empty()) {
+				send_to(connection, g_server_id, message_type, advertisers);
+			}
+		} break;
+		case SignalMessageType::ServerSetID: {
+			connection.id = NetAddress{base64::from_base64(data)};
+		} break;
+		case SignalMessageType::ServerEcho: {
+			send_to(connection, peer, message_type, data);
+		} break;
+		case SignalMessageType::JuiceTurnCredentials: {
+			// Loopback runs never use TURN
+		} break;
+		default: {
+			if (auto target = find(peer)) {
+				if (is_blocked(connection, *target, message_type)) {
+					break;
+				}
+				send_to(*target, connection.id, message_type, data);
+			} else {
+				spdlog::warn("local signaling server: {} not connected", peer.b64());
+			}
+		} break;
+	}
+}
+
+void LocalSignalingServer::send_to(Connection& connection, const NetAddress& from, s32 message_type, const std::string& data) {
+	const Json json = {
+		{"peer_id", from.b64()},
+		{"message_type", message_type},
+		{"data", data},
+	};
+	const auto buffer = json.dump() + Delimiter;
+	send(connection.socket, buffer.c_str(), buffer.size(), MSG_NOSIGNAL);
+}
+
+LocalSignalingServer::Connection* LocalSignalingServer::find(const NetAddress& id) {
+	for (auto& connection : m_connections) {
+		if (connection.id == id) {
+			return &connection;
+		}
+	}
+	return nullptr;
+}
+
+// The descriptions still go through, without any candidates both sides give up on ICE
+bool LocalSignalingServer::is_blocked(const Connection& from, const Connection& to, s32 message_type) const {
+	switch (SignalMessageType{message_type}) {
+		case SignalMessageType::JuciceCandidate:
+		case SignalMessageType::JuiceCandidateBatch:
+		case SignalMessageType::JuiceRelayCandidate:
+		case SignalMessageType::JuiceRelayCandidateBatch:
+			break;
+		default:
+			return false;
+	}
+	const auto first = std::min(from.order, to.order);
+	const auto second = std::max(from.order, to.order);
+	return first == 0 && second >= 1 && second <= m_blocked_peers;
+}
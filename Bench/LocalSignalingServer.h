@@ -0,0 +1,49 @@
+#pragma once
+#include "Common.h"
+#include <thread>
+
+// Minimal in-process stand-in for signaling/server.py: hands out peer IDs, tracks advertisers
+// and forwards everything else to the addressed peer. No TURN credentials are handed out.
+class LocalSignalingServer {
+public:
+	LocalSignalingServer(u16 port = 0);
+	~LocalSignalingServer();
+
+	LocalSignalingServer(const LocalSignalingServer&) = delete;
+	LocalSignalingServer& operator=(const LocalSignalingServer&) = delete;
+
+	u16 port() const { return m_port; }
+	// Drops the ICE candidates between the first peer to connect and the next `peers`, so their
+	// sessions fail and their traffic has to be forwarded. Call before start().
+	void block_direct(u32 peers) { m_blocked_peers = peers; }
+	void start();
+	void stop();
+
+private:
+	struct Connection {
+		SOCKET socket = 0;
+		NetAddress id{};
+		bool advertising = false;
+		u32 order = 0; // how many connected before it
+		std::string buffer;
+	};
+
+	void run();
+	void accept_connection();
+	bool receive_from(Connection& connection);
+	void handle_message(Connection& connection, const Json& json);
+	void send_to(Connection& connection, const NetAddress& from, s32 message_type, const std::string& data);
+	Connection* find(const NetAddress& id);
+	bool is_blocked(const Connection& from, const Connection& to, s32 message_type) const;
+
+private:
+	inline static const std::string Delimiter = "-+";
+
+	SOCKET m_listen_socket = 0;
+	u16 m_port = 0;
+	std::atomic<bool> m_is_running = false;
+	std::vector<Connection> m_connections;
+	u32 m_next_order = 0;
+	u32 m_blocked_peers = 0;
+	std::jthread m_thread;
+};
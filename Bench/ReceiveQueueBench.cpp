@@ -0,0 +1,99 @@
+// Checks and times ReceiveQueue: several producer threads push bursts of packets the way agents'
+// juice threads do, a consumer waits on the receive event and drains the queue the way Storm does.
+// A consumer that times out while a packet is waiting means a wakeup was lost, the bench then exits
+// non-zero. Also counts how often the event is set compared to one set per packet.
+#include "../SNP/ReceiveQueue.h"
+
+#include <random>
+#include <thread>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr u32 MAX_PRODUCERS = 64;
+
+struct RunResult {
+	u64 pushed = 0;
+	u64 received = 0;
+	u64 wakeups = 0;
+	u64 lost_wakeups = 0;
+	f64 seconds = 0;
+};
+
+// Every producer pushes a burst of 1 to max_burst packets and waits until all of it was received.
+// Once every producer waits nothing else can set the event, so a missed set() leaves the consumer
+// timing out with packets in the queue.
+static RunResult run(u32 producers, u32 seconds, u32 max_burst) {
+	platform::Event event;
+	ReceiveQueue queue{[&event] { event.set(); }};
+	std::atomic<bool> producing = true;
+	std::atomic<u64> received[MAX_PRODUCERS]{};
+	RunResult result;
+
+	std::vector<std::jthread> threads;
+	for (u32 i = 0; i < producers; i++) {
+		threads.emplace_back([&, i] {
+			std::mt19937 rng{i};
+			NetAddress sender{};
+			sender.bytes[0] = (u8)i;
+			char data[64]{};
+			u64 pushed = 0;
+			while (producing) {
+				const auto burst = 1 + rng() % max_burst;
+				for (u32 j = 0; j < burst; j++) {
+					queue.push(GamePacket{sender, data, sizeof(data)});
+				}
+				pushed += burst;
+				while (producing && received[i] < pushed) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	const auto start = Clock::now();
+	const auto end = start + std::chrono::seconds{seconds};
+	GamePacket packet;
+	while (true) {
+		const bool woken = event.wait_for(100ms);
+		const bool done = Clock::now() >= end;
+		if (done) {
+			producing = false;
+			threads.clear();
+		}
+		bool drained_any = false;
+		while (queue.try_pop(packet)) {
+			received[packet.sender.bytes[0]]++;
+			result.received++;
+			drained_any = true;
+		}
+		if (!woken && drained_any && !done) {
+			result.lost_wakeups++;
+		}
+		if (done) {
+			break;
+		}
+	}
+	result.seconds = std::chrono::duration<f64>(Clock::now() - start).count();
+	result.pushed = queue.pushed();
+	result.wakeups = queue.wakeups();
+	return result;
+}
+
+int main(int argc, char** argv) {
+	const u32 producers = std::min(argc > 1 ? (u32)std::stoul(argv[1]) : 8, MAX_PRODUCERS);
+	const u32 seconds = argc > 2 ? (u32)std::stoul(argv[2]) : 5;
+
+	bool passed = true;
+	printf("%u producers, %u s per run\n", producers, seconds);
+	printf("%6s %12s %12s %12s %11s %10s %6s\n", "burst", "packets", "pkt/s", "events/s", "events/pkt", "lost", "ok");
+	for (const u32 burst : {1, 8, 64}) {
+		const auto result = run(producers, seconds, burst);
+		const bool ok = result.lost_wakeups == 0 && result.received == result.pushed;
+		passed &= ok;
+		printf("%6u %12llu %12.0f %12.0f %11.3f %10llu %6s\n", burst, result.pushed, result.pushed / result.seconds,
+			result.wakeups / result.seconds, result.pushed ? (f64)result.wakeups / result.pushed : 0.0,
+			result.lost_wakeups, ok ? "yes" : "NO");
+	}
+	return passed ? 0 : 1;
+}
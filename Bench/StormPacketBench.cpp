@@ -0,0 +1,136 @@
+// Checks and times StormPacketView: classifies the packets captured in SC Networking.md, fuzzes the
+// parser with mutated and random input (build with CROWNLINK_SANITIZE to catch bad reads) and
+// measures classification throughput.
+#include "../NetShared/StormPacket.h"
+
+#include <random>
+#include <cctype>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+struct CapturedPacket {
+	const char* name;
+	std::vector<u8> bytes;
+	StormPacketClass expected;
+};
+
+static std::vector<u8> from_hex(const char* text) {
+	std::vector<u8> result;
+	for (const char* c = text; c[0] && c[1]; c++) {
+		if (isxdigit(c[0]) && isxdigit(c[1])) {
+			result.push_back((u8)std::stoi(std::string{c, 2}, nullptr, 16));
+			c++;
+		}
+	}
+	return result;
+}
+
+static std::vector<CapturedPacket> captured_packets() {
+	return {
+		{"keepalive", from_hex("74 30 0d 00 23 00 23 00 02 00 01 00 05"), StormPacketClass::Keepalive},
+		{"join lobby", from_hex("28 c4 10 00 00 00 01 00 00 01 ff 00 01 00 00 00"), StormPacketClass::System},
+		{"player name", from_hex("6c 78 14 00 02 00 02 00 00 07 ff 00 4a 65 73 73 65 00 00 00"), StormPacketClass::System},
+		{"ping", from_hex("4d 99 0c 00 06 00 03 00 00 04 00 00"), StormPacketClass::Ping},
+		{"ping response", from_hex("69 7a 0c 00 03 00 07 00 00 05 01 00"), StormPacketClass::Ping},
+		{"ack", from_hex("5f 82 0c 00 08 00 08 00 00 00 01 01"), StormPacketClass::Ack},
+		{"map data", from_hex(
+			"58 b0 4e 00 02 00 03 00 00 08 00 00 01 00 00 00 08 00 00 00 16 00 00 00 04 00 00 00 05 00 00 00"
+			"4a 65 73 73 65 00 2c 34 34 2c 2c 33 2c 2c 31 65 2c 2c 31 2c 63 62 32 65 64 61 61 62 2c 31 2c 2c"
+			"4a 65 73 73 65 0d 41 78 69 6f 6d 0d 00 00"), StormPacketClass::System},
+		{"truncated", from_hex("74 30 0d 00 23 00"), StormPacketClass::Invalid},
+	};
+}
+
+// The view only reads bytes, so it can be exercised at compile time
+static constexpr char CONSTEXPR_KEEPALIVE[] = {0x74, 0x30, 0x0d, 0x00, 0x23, 0x00, 0x23, 0x00, 0x02, 0x00, 0x01, 0x00, 0x05};
+static_assert(StormPacketView{CONSTEXPR_KEEPALIVE, sizeof(CONSTEXPR_KEEPALIVE)}.classify() == StormPacketClass::Keepalive);
+static_assert(StormPacketView{CONSTEXPR_KEEPALIVE, sizeof(CONSTEXPR_KEEPALIVE)}.sequence() == 0x23);
+static_assert(StormPacketView{CONSTEXPR_KEEPALIVE, 4}.classify() == StormPacketClass::Invalid);
+
+static bool check_captured(const std::vector<CapturedPacket>& packets) {
+	bool ok = true;
+	for (const auto& packet : packets) {
+		const StormPacketView view{(const char*)packet.bytes.data(), packet.bytes.size()};
+		const auto result = view.classify();
+		printf("%-14s %-16s %s\n", packet.name, short_name(result).c_str(), view.describe().c_str());
+		if (result != packet.expected) {
+			printf("  expected %s\n", short_name(packet.expected).c_str());
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Invariants that must hold for any input, every byte read goes through a vector sized exactly
+// to the input so a sanitizer build flags anything past the end
+static bool fuzz(const std::vector<CapturedPacket>& packets, u32 iterations) {
+	std::mt19937 rng{1583};
+	std::uniform_int_distribution<u32> byte{0, 255};
+	u64 valid = 0;
+	for (u32 i = 0; i < iterations; i++) {
+		std::vector<u8> input;
+		if (i % 2) {
+			input = packets[rng() % packets.size()].bytes;
+			const auto mutations = 1 + rng() % 4;
+			for (u32 m = 0; m < mutations && !input.empty(); m++) {
+				input[rng() % input.size()] = (u8)byte(rng);
+			}
+			input.resize(rng() % (input.size() + 8), 0);
+		} else {
+			input.resize(rng() % 600);
+			for (auto& b : input) {
+				b = (u8)byte(rng);
+			}
+		}
+
+		const auto data = std::make_unique<char[]>(input.size());
+		std::copy(input.begin(), input.end(), data.get());
+		const StormPacketView view{data.get(), input.size()};
+		const auto result = view.classify();
+		view.describe();
+		if (!view.valid()) {
+			if (result != StormPacketClass::Invalid) {
+				printf("fuzz: invalid packet classified as %s\n", short_name(result).c_str());
+				return false;
+			}
+			continue;
+		}
+		valid++;
+		if (result == StormPacketClass::Invalid || view.payload_size() + StormPacketView::HEADER_SIZE > input.size()) {
+			printf("fuzz: inconsistent view for %s\n", view.describe().c_str());
+			return false;
+		}
+	}
+	printf("fuzz: %u inputs, %llu parsed as valid\n", iterations, valid);
+	return true;
+}
+
+static void throughput(const std::vector<CapturedPacket>& packets, u32 rounds) {
+	u64 counts[STORM_PACKET_CLASSES]{};
+	const auto start = Clock::now();
+	for (u32 round = 0; round < rounds; round++) {
+		for (const auto& packet : packets) {
+			counts[(size_t)StormPacketView{(const char*)packet.bytes.data(), packet.bytes.size()}.classify()]++;
+		}
+	}
+	const auto elapsed = std::chrono::duration<f64>(Clock::now() - start).count();
+	const auto total = (f64)rounds * packets.size();
+
+	u64 checksum = 0;
+	for (auto count : counts) {
+		checksum += count;
+	}
+	printf("throughput: %.0f packets in %.3f s, %.1f M packets/s, %.2f ns/packet (%llu)\n",
+		total, elapsed, total / elapsed / 1e6, elapsed * 1e9 / total, checksum);
+}
+
+int main(int argc, char** argv) {
+	const u32 iterations = argc > 1 ? (u32)std::stoul(argv[1]) : 1'000'000;
+	const auto packets = captured_packets();
+
+	const bool captured_ok = check_captured(packets);
+	const bool fuzz_ok = fuzz(packets, iterations);
+	throughput(packets, 10'000'000);
+	return captured_ok && fuzz_ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// Checks and times the timer wheel on a simulated clock, so timers spanning every level and beyond
+// the top one cascade down in well under a second. Checks that no timer fires early, none fires
+// late when the wheel is advanced when it asks to be, cancelled timers never fire and all others
+// fire exactly once, including timers scheduled from callbacks. Also checks the off-thread wakeup
+// and measures schedule, cancel and fire costs.
+#include "../SNP/TimerWheel.h"
+
+#include <random>
+#include <cstdio>
+
+using Clock = TimerWheel::Clock;
+
+static Clock::time_point g_now = Clock::now();
+
+static TimerWheel::Clock::time_point simulated_now() {
+	return g_now;
+}
+
+constexpr u64 TOP_LEVEL_TICKS = u64{1} << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS);
+
+struct Tracked {
+	Clock::time_point due;
+	TimerWheel::TimerId id = 0;
+	bool cancelled = false;
+	u32 fired = 0;
+	Clock::duration late{};
+	bool overdue_before = false; // an earlier advance already passed it by more than a tick
+};
+
+class Run {
+public:
+	Run(u32 seed) : m_rng{seed} {}
+
+	// Delays from a single tick up to twice what the top level covers
+	Clock::duration random_delay() {
+		const u32 level = m_rng() % (TimerWheel::LEVELS + 1);
+		const u64 ticks = level < TimerWheel::LEVELS ? u64{1} << (TimerWheel::SLOT_BITS * (level + 1)) : 2 * TOP_LEVEL_TICKS;
+		return TimerWheel::TICK * (s64)(m_rng() % ticks) + std::chrono::microseconds{m_rng() % 10'000};
+	}
+
+	void schedule(Clock::duration delay) {
+		const auto index = m_timers.size();
+		m_timers.push_back({g_now + delay});
+		m_timers[index].id = m_wheel.schedule(delay, [this, index] {
+			auto& timer = m_timers[index];
+			timer.fired++;
+			timer.late = g_now - timer.due;
+			timer.overdue_before = m_last_advance - timer.due >= 2 * TimerWheel::TICK;
+			// Like agent expiry, some timers schedule the next one themselves
+			if (m_rng() % 10 == 0) {
+				schedule(random_delay());
+			}
+		});
+	}
+
+	void cancel_some() {
+		auto& timer = m_timers[m_rng() % m_timers.size()];
+		if (!timer.fired && !timer.cancelled) {
+			timer.cancelled = true;
+			m_wheel.cancel(timer.id);
+		}
+	}
+
+	// steps returns how far to move the clock, given what the wheel asked for
+	template <typename Step>
+	bool run(const char* name, u32 timers, Step step) {
+		for (u32 i = 0; i < timers; i++) {
+			schedule(random_delay());
+		}
+		u64 advances = 0;
+		while (m_wheel.size()) {
+			const auto wait = m_wheel.advance(std::chrono::hours{1});
+			m_last_advance = g_now;
+			advances++;
+			if (m_rng() % 4 == 0) {
+				cancel_some();
+			}
+			g_now += std::max<Clock::duration>(step(wait), std::chrono::nanoseconds{1});
+		}
+
+		u64 fired = 0, cancelled = 0, early = 0, overdue = 0, repeated = 0, cancelled_fired = 0;
+		Clock::duration max_late{};
+		for (const auto& timer : m_timers) {
+			fired += timer.fired != 0;
+			cancelled += timer.cancelled;
+			repeated += timer.fired > 1;
+			cancelled_fired += timer.cancelled && timer.fired;
+			early += timer.fired && timer.late < Clock::duration{};
+			overdue += timer.fired && timer.overdue_before;
+			if (timer.fired) {
+				max_late = std::max(max_late, timer.late);
+			}
+		}
+		const u64 missed = m_timers.size() - fired - cancelled;
+		const bool ok = !early && !overdue && !repeated && !cancelled_fired && !missed;
+		printf("%-14s %s  %zu timers, %llu fired, %llu cancelled, %llu advances, latest %.1f ms after due"
+			" (early %llu, overdue %llu, repeated %llu, missed %llu, cancelled but fired %llu)\n",
+			name, ok ? "ok  " : "FAIL", m_timers.size(), fired, cancelled, advances,
+			std::chrono::duration<f64, std::milli>(max_late).count(), early, overdue, repeated, missed, cancelled_fired);
+		return ok;
+	}
+
+	Clock::duration max_late() const {
+		Clock::duration result{};
+		for (const auto& timer : m_timers) {
+			result = std::max(result, timer.late);
+		}
+		return result;
+	}
+
+private:
+	std::mt19937_64 m_rng;
+	TimerWheel m_wheel{simulated_now};
+	std::vector<Tracked> m_timers;
+	Clock::time_point m_last_advance = g_now;
+};
+
+static bool check_cascading() {
+	bool ok = true;
+	{
+		// Sleeping exactly as long as the wheel says must never make a timer more than a tick late
+		Run run{43};
+		ok &= run.run("as asked", 20'000, [](Clock::duration wait) { return wait; });
+		if (run.max_late() > 2 * TimerWheel::TICK) {
+			printf("  a timer fired %.1f ms late\n", std::chrono::duration<f64, std::milli>(run.max_late()).count());
+			ok = false;
+		}
+	}
+	{
+		// Oversleeping by anything from a millisecond to a day, every due timer fires on the next advance
+		std::mt19937 rng{44};
+		Run run{44};
+		ok &= run.run("random jumps", 20'000, [&](Clock::duration) {
+			const u32 kind = rng() % 20;
+			const auto limit = kind < 10 ? std::chrono::milliseconds{30} : kind < 16 ? std::chrono::milliseconds{10'000}
+				: kind < 19 ? std::chrono::milliseconds{3'600'000} : std::chrono::milliseconds{86'400'000};
+			return Clock::duration{std::chrono::milliseconds{1 + rng() % limit.count()}};
+		});
+	}
+	return ok;
+}
+
+// A timer scheduled from another thread wakes the advancing thread only if it is due before the wait ends
+static bool check_wakeup() {
+	TimerWheel wheel{simulated_now};
+	u32 wakeups = 0;
+	wheel.set_wakeup([&] { wakeups++; });
+	wheel.schedule(std::chrono::seconds{10}, [] {});
+	const auto wait = wheel.advance(std::chrono::hours{1});
+
+	std::thread{[&] {
+		wheel.schedule(std::chrono::seconds{20}, [] {});
+		wheel.schedule(std::chrono::milliseconds{50}, [] {});
+		wheel.schedule(std::chrono::milliseconds{60}, [] {});
+	}}.join();
+	// The advancing thread computes its next wait itself
+	wheel.schedule(std::chrono::milliseconds{10}, [] {});
+
+	const bool ok = wait <= std::chrono::seconds{10} && wakeups == 1;
+	printf("%-14s %s  first wait %.0f ms, %u wakeups\n", "wakeup", ok ? "ok  " : "FAIL",
+		std::chrono::duration<f64, std::milli>(wait).count(), wakeups);
+	return ok;
+}
+
+static void throughput(u32 count) {
+	std::mt19937 rng{45};
+	TimerWheel wheel{simulated_now};
+	std::vector<TimerWheel::TimerId> ids;
+	ids.reserve(count);
+	u64 fired = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < count; i++) {
+		ids.push_back(wheel.schedule(std::chrono::milliseconds{rng() % 600'000}, [&] { fired++; }));
+	}
+	const auto schedule_elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+	// Half of them get pushed back by traffic before they are due, like agent expiry
+	start = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < count; i += 2) {
+		wheel.cancel(ids[i]);
+	}
+	const auto cancel_elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+	u64 advances = 0;
+	start = std::chrono::steady_clock::now();
+	while (wheel.size()) {
+		g_now += wheel.advance(std::chrono::hours{1});
+		advances++;
+	}
+	const auto fire_elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+	printf("throughput: schedule %.0f ns, cancel %.0f ns, fire %.0f ns per timer, %llu fired over %llu advances\n",
+		schedule_elapsed * 1e9 / count, cancel_elapsed * 1e9 / (count / 2), fire_elapsed * 1e9 / fired, fired, advances);
+}
+
+int main(int argc, char** argv) {
+	const u32 timers = argc > 1 ? (u32)std::stoul(argv[1]) : 1'000'000;
+
+	const bool cascading_ok = check_cascading();
+	const bool wakeup_ok = check_wakeup();
+	throughput(timers);
+	return cascading_ok && wakeup_ok ? 0 : 1;
+}
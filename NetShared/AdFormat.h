@@ -0,0 +1,125 @@
+#pragma once
+#include "../shared_common.h"
+#include "StormTypes.h"
+#include <string_view>
+
+// Wire format of a lobby ad in GameAd messages. Older clients memcpy the whole AdFile, pointers and
+// padding included, so its size and layout depend on the build. This one only carries what the
+// host decides, in a fixed layout:
+//
+//   magic u8, version u8,
+//   varint game_state, creation_time, host_latency, category_bits, program_id, version_id, crownlink_mode,
+//   varint length + bytes of game_name, game_description and extra_bytes
+//
+// The receiver fills in game_index, host and host_last_time itself, as it always did.
+// Hosts only send it to browsers whose SolicitAds carries AD_FORMAT_VERSION, decode() still
+// takes raw AdFiles from older hosts.
+namespace ad_format {
+
+constexpr u8 AD_FORMAT_MAGIC = 0xad; // a raw AdFile starts with game_index, always 0 from the host
+constexpr u8 AD_FORMAT_VERSION = 1;
+
+inline void write_varint(std::string& out, u32 value) {
+    while (value >= 0x80) {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+inline bool read_varint(std::string_view& in, u32& value) {
+    value = 0;
+    for (u32 shift = 0; shift < 35; shift += 7) {
+        if (in.empty()) {
+            return false;
+        }
+        const u8 byte = (u8)in.front();
+        in.remove_prefix(1);
+        value |= (u32)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void write_bytes(std::string& out, const char* data, size_t size) {
+    write_varint(out, (u32)size);
+    out.append(data, size);
+}
+
+// Fails if the bytes do not fit in capacity, the rest of out is zeroed
+inline bool read_bytes(std::string_view& in, char* out, size_t capacity, u32* out_size = nullptr) {
+    u32 size;
+    if (!read_varint(in, size) || size > in.size() || size > capacity) {
+        return false;
+    }
+    memset(out, 0, capacity);
+    memcpy(out, in.data(), size);
+    in.remove_prefix(size);
+    if (out_size) {
+        *out_size = size;
+    }
+    return true;
+}
+
+inline std::string encode(const AdFile& ad) {
+    const auto& game = ad.game_info;
+    std::string out;
+    out.reserve(64);
+    out += (char)AD_FORMAT_MAGIC;
+    out += (char)AD_FORMAT_VERSION;
+    for (const u32 value : {game.game_state, game.creation_time, game.host_latency, game.category_bits,
+            game.program_id, game.version_id, (u32)ad.crownlink_mode}) {
+        write_varint(out, value);
+    }
+    // Names keep their terminator out, the receiver's buffers are zeroed
+    write_bytes(out, game.game_name, strnlen(game.game_name, sizeof(game.game_name) - 1));
+    write_bytes(out, game.game_description, strnlen(game.game_description, sizeof(game.game_description) - 1));
+    write_bytes(out, ad.extra_bytes, std::min<size_t>(game.extra_bytes, sizeof(ad.extra_bytes)));
+    return out;
+}
+
+inline bool is_encoded(std::string_view data) {
+    return data.size() >= 2 && (u8)data[0] == AD_FORMAT_MAGIC;
+}
+
+// Accepts both this format and a raw AdFile, returns false if data is neither
+inline bool decode(std::string_view data, AdFile& ad) {
+    ad = AdFile{};
+    if (!is_encoded(data)) {
+        if (data.empty()) {
+            return false;
+        }
+        memcpy(&ad, data.data(), std::min(data.size(), sizeof(ad)));
+        return true;
+    }
+    if ((u8)data[1] != AD_FORMAT_VERSION) {
+        return false;
+    }
+    data.remove_prefix(2);
+
+    auto& game = ad.game_info;
+    u32 mode;
+    u32* const fields[] = {&game.game_state, &game.creation_time, &game.host_latency, &game.category_bits,
+        &game.program_id, &game.version_id, &mode};
+    for (u32* field : fields) {
+        if (!read_varint(data, *field)) {
+            return false;
+        }
+    }
+    ad.crownlink_mode = (CrownLinkMode)mode;
+
+    if (!read_bytes(data, game.game_name, sizeof(game.game_name) - 1)
+            || !read_bytes(data, game.game_description, sizeof(game.game_description) - 1)) {
+        return false;
+    }
+    u32 extra_size;
+    if (!read_bytes(data, ad.extra_bytes, sizeof(ad.extra_bytes), &extra_size)) {
+        return false;
+    }
+    game.extra_bytes = extra_size;
+    return true;
+}
+
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include "../shared_common.h"
+#include <string_view>
+#include <stdexcept>
+#include <array>
+
+// Base64 for the signaling path: every message carries a peer ID, every ad and log line encodes one.
+// Same alphabet and padding as include/base64.hpp, but it writes into the caller's buffer, has a fixed
+// path for 16 byte peer IDs and does 12 bytes at a time with SSSE3 when the build targets it
+// (CROWNLINK_SIMD, or any -mssse3 / /arch:AVX build). The scalar path is always there.
+#if defined(__SSSE3__) || defined(__AVX__)
+#define CROWNLINK_BASE64_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+namespace fast_base64 {
+
+constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+// A NetAddress, 16 bytes
+constexpr size_t ADDRESS_SIZE = 16;
+constexpr size_t ADDRESS_CHARS = 24;
+
+constexpr size_t encoded_size(size_t size) { return (size + 2) / 3 * 4; }
+
+namespace detail {
+
+// One table per position in a group holding the value already shifted into place, so a group is
+// four lookups ORed together. Characters outside the alphabet set the top bit.
+constexpr u32 INVALID_BIT = 0x80000000;
+using DecodeTables = std::array<std::array<u32, 256>, 4>;
+
+constexpr DecodeTables DECODE_TABLES = [] {
+    DecodeTables tables{};
+    for (u32 position = 0; position < 4; position++) {
+        tables[position].fill(INVALID_BIT);
+        for (u32 i = 0; i < 64; i++) {
+            tables[position][(u8)ALPHABET[i]] = i << (18 - 6 * position);
+        }
+    }
+    return tables;
+}();
+
+inline void encode_group(const u8* in, char* out) {
+    const u32 value = in[0] << 16 | in[1] << 8 | in[2];
+    out[0] = ALPHABET[value >> 18];
+    out[1] = ALPHABET[value >> 12 & 0x3f];
+    out[2] = ALPHABET[value >> 6 & 0x3f];
+    out[3] = ALPHABET[value & 0x3f];
+}
+
+// Returns false on a character outside the alphabet
+inline bool decode_group(const u8* in, u8* out) {
+    const u32 value = DECODE_TABLES[0][in[0]] | DECODE_TABLES[1][in[1]] | DECODE_TABLES[2][in[2]] | DECODE_TABLES[3][in[3]];
+    if (value & INVALID_BIT) {
+        return false;
+    }
+    out[0] = (u8)(value >> 16);
+    out[1] = (u8)(value >> 8);
+    out[2] = (u8)value;
+    return true;
+}
+
+#ifdef CROWNLINK_BASE64_SSSE3
+// Reads 16 bytes and encodes the first 12 into 16 chars, see W. Mula, "Base64 encoding with SIMD instructions"
+inline void encode_block(const u8* in, char* out) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+    bytes = _mm_shuffle_epi8(bytes, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    const __m128i low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(high, low);
+
+    // Every range of the alphabet is the index plus a constant, picked with one shuffle
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+    _mm_storeu_si128((__m128i*)out, chars);
+}
+
+inline __m128i in_range(__m128i chars, char first, char last) {
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8((char)(first - 1))), _mm_cmpgt_epi8(_mm_set1_epi8((char)(last + 1)), chars));
+}
+
+// Decodes 16 chars into 12 bytes but writes 16, returns false on a character outside the alphabet
+inline bool decode_block(const char* in, u8* out) {
+    const __m128i chars = _mm_loadu_si128((const __m128i*)in);
+    // Bytes above 0x7f are negative here and fall outside every range
+    const __m128i upper = in_range(chars, 'A', 'Z');
+    const __m128i lower = in_range(chars, 'a', 'z');
+    const __m128i digit = in_range(chars, '0', '9');
+    const __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+    const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+    if (_mm_movemask_epi8(valid) != 0xffff) {
+        return false;
+    }
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8((char)-'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8((char)(26 - 'a'))));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8((char)(52 - '0'))));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8((char)(62 - '+'))));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8((char)(63 - '/'))));
+    const __m128i values = _mm_add_epi8(chars, shift);
+
+    // Four 6 bit values into three bytes per lane, big endian within each lane
+    const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i lanes = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    const __m128i bytes = _mm_shuffle_epi8(lanes, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i*)out, bytes);
+    return true;
+}
+#endif
+
+}
+
+// Writes encoded_size(size) chars to out, no terminator
+inline size_t encode(const void* data, size_t size, char* out) {
+    const u8* in = (const u8*)data;
+    size_t i = 0;
+    char* cursor = out;
+#ifdef CROWNLINK_BASE64_SSSE3
+    // A block reads 16 bytes but only consumes 12
+    for (; i + 16 <= size; i += 12, cursor += 16) {
+        detail::encode_block(in + i, cursor);
+    }
+#endif
+    for (; i + 3 <= size; i += 3, cursor += 4) {
+        detail::encode_group(in + i, cursor);
+    }
+    if (i < size) {
+        u8 tail[3]{};
+        memcpy(tail, in + i, size - i);
+        detail::encode_group(tail, cursor);
+        cursor[3] = '=';
+        if (size - i == 1) {
+            cursor[2] = '=';
+        }
+        cursor += 4;
+    }
+    return cursor - out;
+}
+
+// Returns the decoded size, or 0 if the text is malformed or does not fit in capacity
+inline size_t decode(std::string_view text, void* out, size_t capacity) {
+    if (text.empty() || text.size() % 4) {
+        return 0;
+    }
+    const size_t padding = (text.back() == '=') + (text[text.size() - 2] == '=');
+    const size_t decoded_size = text.size() / 4 * 3 - padding;
+    if (decoded_size > capacity) {
+        return 0;
+    }
+
+    const u8* in = (const u8*)text.data();
+    u8* cursor = (u8*)out;
+    size_t i = 0;
+    // The last group may be padded, it always takes the scalar path
+    const size_t full = text.size() - 4;
+#ifdef CROWNLINK_BASE64_SSSE3
+    // A block writes 4 bytes past its 12, the two groups after it make at least that many
+    for (; i + 16 + 4 <= full; i += 16, cursor += 12) {
+        if (!detail::decode_block(text.data() + i, cursor)) {
+            return 0;
+        }
+    }
+#endif
+    for (; i < full; i += 4, cursor += 3) {
+        if (!detail::decode_group(in + i, cursor)) {
+            return 0;
+        }
+    }
+
+    u8 last[4] = {in[i], in[i + 1], padding == 2 ? (u8)'A' : in[i + 2], padding ? (u8)'A' : in[i + 3]};
+    u8 tail[3];
+    if (!detail::decode_group(last, tail)) {
+        return 0;
+    }
+    memcpy(cursor, tail, 3 - padding);
+    return decoded_size;
+}
+
+// Peer IDs are always 16 bytes, 24 chars with two padding chars. The block fills the whole
+// address, its last 4 bytes are then overwritten with the real ones.
+inline void encode_address(const u8* address, char* out) {
+#ifdef CROWNLINK_BASE64_SSSE3
+    detail::encode_block(address, out);
+#else
+    for (size_t i = 0; i < 12; i += 3) {
+        detail::encode_group(address + i, out + i / 3 * 4);
+    }
+#endif
+    detail::encode_group(address + 12, out + 16);
+    const u8 last[3] = {address[15], 0, 0};
+    detail::encode_group(last, out + 20);
+    out[22] = '=';
+    out[23] = '=';
+}
+
+inline bool decode_address(std::string_view text, u8* address) {
+    if (text.size() != ADDRESS_CHARS || text[22] != '=' || text[23] != '=') {
+        return false;
+    }
+    const u8* in = (const u8*)text.data();
+#ifdef CROWNLINK_BASE64_SSSE3
+    if (!detail::decode_block(text.data(), address)) {
+        return false;
+    }
+#else
+    for (size_t i = 0; i < 12; i += 3) {
+        if (!detail::decode_group(in + i / 3 * 4, address + i)) {
+            return false;
+        }
+    }
+#endif
+    u8 tail[3];
+    const u8 last[4] = {in[20], in[21], 'A', 'A'};
+    if (!detail::decode_group(in + 16, address + 12) || !detail::decode_group(last, tail)) {
+        return false;
+    }
+    address[15] = tail[0];
+    return true;
+}
+
+// Drop-in replacements for base64::to_base64 / from_base64 that allocate the result once,
+// from_base64 throws like the original on malformed input
+inline std::string to_base64(std::string_view data) {
+    std::string out(encoded_size(data.size()), '\0');
+    encode(data.data(), data.size(), out.data());
+    return out;
+}
+
+inline std::string from_base64(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    std::string out(text.size() / 4 * 3, '\0');
+    const auto size = decode(text, out.data(), out.size());
+    if (!size) {
+        throw std::runtime_error{"Invalid base64 encoded data"};
+    }
+    out.resize(size);
+    return out;
+}
+
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include "../shared_common.h"
+#include <cstdio>
+#include <atomic>
+
+// Storm's packet HEADER from snet.cpp, see SC Networking.md:
+// checksum u16, bytes u16, sequence u16, acksequence u16, type u8, subtype u8, playerid u8, flags u8
+
+enum class StormType : u8 {
+    System = 0,
+    Message = 1,
+    Turn = 2,
+};
+
+enum StormFlags : u8 {
+    STORM_FLAG_ACK = 0x01,
+    STORM_FLAG_RESEND_REQUEST = 0x02,
+    STORM_FLAG_FORWARDED = 0x04,
+};
+
+enum class StormSystemMessage : u8 {
+    Unused = 0,
+    InitialContact,
+    CircuitCheck,
+    CircuitCheckResponse,
+    Ping,
+    PingResponse,
+    PlayerInfo,
+    PlayerJoin,
+    PlayerJoinAcceptStart,
+    PlayerJoinAcceptDone,
+    PlayerJoinReject,
+    PlayerLeave,
+    DropPlayer,
+    NewGameOwner,
+};
+
+// What the transport cares about, roughly from most to least urgent
+enum class StormPacketClass : u8 {
+    Invalid,       // too short, or its size field does not fit, not from Storm
+    Ack,           // header only, acknowledges the peer's sequence
+    ResendRequest, // asks the peer to resend a lost packet
+    Keepalive,     // turn packet without game data, sent while waiting (countdown, drop player screen)
+    Ping,          // system ping / circuit check and their responses
+    Turn,
+    Message,
+    System,
+};
+
+constexpr size_t STORM_PACKET_CLASSES = (size_t)StormPacketClass::System + 1;
+
+inline std::string to_string(StormPacketClass value) {
+    switch (value) {
+        EnumStringCase(StormPacketClass::Invalid);
+        EnumStringCase(StormPacketClass::Ack);
+        EnumStringCase(StormPacketClass::ResendRequest);
+        EnumStringCase(StormPacketClass::Keepalive);
+        EnumStringCase(StormPacketClass::Ping);
+        EnumStringCase(StormPacketClass::Turn);
+        EnumStringCase(StormPacketClass::Message);
+        EnumStringCase(StormPacketClass::System);
+    }
+    return std::to_string((s32) value);
+}
+
+// to_string without the enum prefix, for logs
+inline std::string short_name(StormPacketClass value) {
+    const auto name = to_string(value);
+    const auto separator = name.rfind(':');
+    return separator == std::string::npos ? name : name.substr(separator + 1);
+}
+
+// Read-only view over a Storm packet, it never copies and reads bytes one at a time so it works
+// on any alignment and in constant expressions
+class StormPacketView {
+public:
+    static constexpr size_t HEADER_SIZE = 12;
+
+    constexpr StormPacketView(const char* data, size_t size) : m_data{data}, m_size{size} {}
+
+    constexpr bool valid() const {
+        return m_size >= HEADER_SIZE && bytes() >= HEADER_SIZE && bytes() <= m_size && (u8)type() <= (u8)StormType::Turn;
+    }
+
+    constexpr u16 checksum() const { return read_u16(0); }
+    constexpr u16 bytes() const { return read_u16(2); }
+    constexpr u16 sequence() const { return read_u16(4); }
+    constexpr u16 ack_sequence() const { return read_u16(6); }
+    constexpr StormType type() const { return (StormType)read_u8(8); }
+    constexpr u8 subtype() const { return read_u8(9); }
+    constexpr u8 player_id() const { return read_u8(10); }
+    constexpr u8 flags() const { return read_u8(11); }
+
+    constexpr bool is_ack() const { return flags() & STORM_FLAG_ACK; }
+    constexpr bool is_resend_request() const { return flags() & STORM_FLAG_RESEND_REQUEST; }
+    // What Storm sends every player, a few times over, when we leave the game or lobby
+    constexpr bool is_player_leave() const {
+        return valid() && !is_ack() && type() == StormType::System && (StormSystemMessage)subtype() == StormSystemMessage::PlayerLeave;
+    }
+
+    // Only meaningful when valid()
+    constexpr const char* payload() const { return m_data + HEADER_SIZE; }
+    constexpr size_t payload_size() const { return bytes() - HEADER_SIZE; }
+
+    constexpr StormPacketClass classify() const {
+        if (!valid()) {
+            return StormPacketClass::Invalid;
+        }
+        if (is_resend_request()) {
+            return StormPacketClass::ResendRequest;
+        }
+        if (is_ack() && payload_size() == 0) {
+            return StormPacketClass::Ack;
+        }
+        switch (type()) {
+            case StormType::System: {
+                switch ((StormSystemMessage)subtype()) {
+                    case StormSystemMessage::CircuitCheck:
+                    case StormSystemMessage::CircuitCheckResponse:
+                    case StormSystemMessage::Ping:
+                    case StormSystemMessage::PingResponse:
+                        return StormPacketClass::Ping;
+                    default:
+                        return StormPacketClass::System;
+                }
+            }
+            case StormType::Message:
+                return StormPacketClass::Message;
+            case StormType::Turn:
+                // The 13 byte "type 0d" packets carry a single status byte and no commands
+                return payload_size() <= 1 ? StormPacketClass::Keepalive : StormPacketClass::Turn;
+        }
+        return StormPacketClass::Invalid;
+    }
+
+    std::string describe() const {
+        if (!valid()) {
+            return "invalid (" + std::to_string(m_size) + " bytes)";
+        }
+        char text[96];
+        snprintf(text, sizeof(text), "%s type %u/%u seq %u ack %u player %u flags 0x%02x, %u bytes",
+            short_name(classify()).c_str(), (u32)type(), (u32)subtype(),
+            (u32)sequence(), (u32)ack_sequence(), (u32)player_id(), (u32)flags(), (u32)bytes());
+        return text;
+    }
+
+private:
+    constexpr u8 read_u8(size_t offset) const { return offset < m_size ? (u8)m_data[offset] : 0; }
+    constexpr u16 read_u16(size_t offset) const { return (u16)(read_u8(offset) | read_u8(offset + 1) << 8); }
+
+private:
+    const char* m_data;
+    size_t m_size;
+};
+
+// Packets per class, for the stats logged when a peer goes away. Counted from every thread
+// that sends or receives for the peer.
+struct StormPacketCounters {
+    std::atomic<u64> counts[STORM_PACKET_CLASSES]{};
+
+    void add(StormPacketClass packet_class) { counts[(size_t)packet_class].fetch_add(1, std::memory_order_relaxed); }
+    u64 operator[](StormPacketClass packet_class) const { return counts[(size_t)packet_class].load(std::memory_order_relaxed); }
+    u64 total() const {
+        u64 result = 0;
+        for (const auto& count : counts) {
+            result += count.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    std::string summary() const {
+        std::string result;
+        for (size_t i = 0; i < STORM_PACKET_CLASSES; i++) {
+            if (const auto count = counts[i].load(std::memory_order_relaxed)) {
+                result += (result.empty() ? "" : ", ") + short_name((StormPacketClass)i) + " " + std::to_string(count);
+            }
+        }
+        return result.empty() ? "none" : result;
+    }
+};
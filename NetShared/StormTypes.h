@@ -1,20 +1,23 @@
 #pragma once
 #include "../shared_common.h"
+#include "Base64.h"
 
 struct NetAddress {
     u8 bytes[16]{};
 
     NetAddress() = default;
     NetAddress(u8* addr) {
-        memcpy_s(&bytes, sizeof(bytes), addr, sizeof(NetAddress));
+        memcpy(&bytes, addr, sizeof(NetAddress));
     }
 
     NetAddress(const std::string& id) {
-        memcpy_s(&bytes, sizeof(bytes), id.c_str(), sizeof(NetAddress));
+        memcpy(&bytes, id.c_str(), std::min(id.size(), sizeof(NetAddress)));
     };
 
     std::string b64() const {
-        return base64::to_base64(std::string((char*)bytes, sizeof(NetAddress)));
+        std::string out(fast_base64::ADDRESS_CHARS, '\0');
+        fast_base64::encode_address(bytes, out.data());
+        return out;
     }
     
     bool operator==(const NetAddress&) const = default;
@@ -123,13 +126,14 @@ struct game {
 struct GamePacket {
     NetAddress sender{};
     u32 size = 0;
-    u32 timestamp = 0;
+    s64 received_ns = 0; // platform::steady_ns() when libjuice handed it over
+    s64 queued_ns = 0;   // when it went into the receive queue
     char data[512]{};
 
     GamePacket() = default;
-    GamePacket(const NetAddress& sender_id, const char* recv_data, const size_t size)
-        : sender{sender_id}, timestamp{GetTickCount()}, size{size} {
-        memcpy_s(data, sizeof(data), recv_data, size);
+    GamePacket(const NetAddress& sender_id, const char* recv_data, const size_t size, s64 received_ns = platform::steady_ns())
+        : sender{sender_id}, size{(u32)std::min(size, sizeof(data))}, received_ns{received_ns} {
+        memcpy(data, recv_data, this->size);
     };
 };
 
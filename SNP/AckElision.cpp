@@ -0,0 +1,18 @@
+#include "AckElision.h"
+
+bool AckElision::suppress(const char* data, size_t size, StormPacketClass packet_class) {
+	if (packet_class != StormPacketClass::Ack) {
+		return false;
+	}
+
+	auto& last = m_last_ack;
+	const auto now = std::chrono::steady_clock::now();
+	if (now - last.time < std::chrono::milliseconds{m_config.window_ms}
+		&& last.contents.size() == size && memcmp(last.contents.data(), data, size) == 0) {
+		m_suppressed++;
+		return true;
+	}
+	last.time = now;
+	last.contents.assign(data, size);
+	return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Common.h"
+
+struct AckElisionConfig {
+	bool enabled = false;
+	u32 window_ms = 100; // an identical ack within this window is not sent again
+};
+
+// Storm repeats header-only acks unchanged while it waits (countdowns, drop player screen), to
+// every peer. A byte for byte repeat inside the window tells the peer nothing new, so it is
+// dropped before it hits the wire. Anything with a new ack or status byte still goes out, so
+// Storm's view of the connection does not change. Keepalives are never dropped: they are turn
+// packets with a sequence number, an identical one is Storm retransmitting it, usually because
+// the peer asked for it, and dropping it would hold up loss recovery.
+class AckElision {
+public:
+	AckElision(const AckElisionConfig& config) : m_config{config} {}
+
+	// Returns true if the packet should not be sent
+	bool suppress(const char* data, size_t size, StormPacketClass packet_class);
+	u64 suppressed() const { return m_suppressed; }
+
+private:
+	struct LastSent {
+		std::chrono::steady_clock::time_point time;
+		std::string contents;
+	};
+
+private:
+	const AckElisionConfig m_config;
+	LastSent m_last_ack;
+	u64 m_suppressed = 0;
+};
@@ -0,0 +1,33 @@
+#include "AgentReaper.h"
+
+AgentReaper::~AgentReaper() {
+	if (m_thread.joinable()) {
+		m_thread.request_stop();
+		m_thread.join();
+	}
+}
+
+void AgentReaper::retire(std::unique_ptr<JuiceAgent> agent) {
+	{
+		std::lock_guard lock{m_mutex};
+		m_retired.push_back(std::move(agent));
+		if (!m_thread.joinable()) {
+			m_thread = std::jthread{[this](std::stop_token stop) { run(stop); }};
+		}
+	}
+	m_cv.notify_one();
+}
+
+void AgentReaper::run(std::stop_token stop) {
+	std::unique_lock lock{m_mutex};
+	while (m_cv.wait(lock, stop, [this] { return !m_retired.empty(); })) {
+		auto agents = std::exchange(m_retired, {});
+		lock.unlock();
+		const auto count = agents.size();
+		const auto start = std::chrono::steady_clock::now();
+		agents.clear();
+		spdlog::debug("Destroyed {} agents in {:.1f} ms", count,
+			std::chrono::duration<f64, std::milli>{std::chrono::steady_clock::now() - start}.count());
+		lock.lock();
+	}
+}
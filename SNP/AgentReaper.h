@@ -0,0 +1,27 @@
+#pragma once
+#include "Common.h"
+#include "JuiceAgent.h"
+#include <thread>
+#include <condition_variable>
+
+// Destroys retired agents on its own thread. juice_destroy joins libjuice's thread and closes its
+// sockets, which must not happen under the manager's lock that spi_send waits on.
+class AgentReaper {
+public:
+	AgentReaper() = default;
+	~AgentReaper();
+
+	AgentReaper(const AgentReaper&) = delete;
+	AgentReaper& operator=(const AgentReaper&) = delete;
+
+	void retire(std::unique_ptr<JuiceAgent> agent);
+
+private:
+	void run(std::stop_token stop);
+
+private:
+	std::vector<std::unique_ptr<JuiceAgent>> m_retired;
+	std::mutex m_mutex;
+	std::condition_variable_any m_cv;
+	std::jthread m_thread;
+};
@@ -0,0 +1,65 @@
+#include "CandidateBatch.h"
+#include "TaskScheduler.h"
+
+void CandidateBatcher::add(const char* sdp) {
+	std::lock_guard lock{m_mutex};
+	if (m_closed) {
+		return;
+	}
+
+	if (!m_pending.empty()) {
+		m_pending += '\n';
+	}
+	m_pending += sdp;
+	if (!m_flush_scheduled) {
+		m_flush_scheduled = true;
+		const auto due = TaskScheduler::Clock::now() + std::chrono::milliseconds{m_config.window_ms};
+		TaskScheduler::instance().schedule(due, [weak = weak_from_this()] {
+			if (auto self = weak.lock()) {
+				std::lock_guard lock{self->m_mutex};
+				self->m_flush_scheduled = false;
+				self->flush(lock);
+			}
+		});
+	}
+}
+
+void CandidateBatcher::finish() {
+	std::lock_guard lock{m_mutex};
+	if (!m_pending.empty()) {
+		m_pending += '\n';
+	}
+	m_pending += END_OF_CANDIDATES;
+	flush(lock);
+}
+
+void CandidateBatcher::close() {
+	std::lock_guard lock{m_mutex};
+	m_closed = true;
+}
+
+void CandidateBatcher::flush(const std::lock_guard<std::mutex>&) {
+	if (m_closed || m_pending.empty()) {
+		return;
+	}
+	m_send(m_pending);
+	m_pending.clear();
+}
+
+void for_each_candidate(const std::string& batch, const std::function<void(const std::string&)>& on_candidate,
+	const std::function<void()>& on_done) {
+	size_t start = 0;
+	while (start < batch.size()) {
+		auto end = batch.find('\n', start);
+		if (end == std::string::npos) {
+			end = batch.size();
+		}
+		const auto line = batch.substr(start, end - start);
+		if (line == END_OF_CANDIDATES) {
+			on_done();
+		} else if (!line.empty()) {
+			on_candidate(line);
+		}
+		start = end + 1;
+	}
+}
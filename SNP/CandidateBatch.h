@@ -0,0 +1,43 @@
+#pragma once
+#include "Common.h"
+
+struct CandidateBatchConfig {
+	bool enabled = false;
+	u32 window_ms = 20; // candidates gathered within this window go out in one signaling message
+};
+
+// Same marker SDP uses, ends a batch when gathering finished so no separate done message is needed
+inline constexpr std::string_view END_OF_CANDIDATES = "a=end-of-candidates";
+
+// Collects trickled local candidates and sends them as one newline separated signaling message
+// per window. Lives in a shared_ptr so a pending flush on the task thread can outlive the agent.
+class CandidateBatcher : public std::enable_shared_from_this<CandidateBatcher> {
+public:
+	using Send = std::function<void(const std::string& batch)>;
+
+	CandidateBatcher(const CandidateBatchConfig& config, Send send) : m_config{config}, m_send{std::move(send)} {}
+
+	CandidateBatcher(const CandidateBatcher&) = delete;
+	CandidateBatcher& operator=(const CandidateBatcher&) = delete;
+
+	void add(const char* sdp);
+	// Sends whatever is pending together with the end marker
+	void finish();
+	// Stops sending, must be called before whatever send refers to goes away
+	void close();
+
+private:
+	void flush(const std::lock_guard<std::mutex>&);
+
+private:
+	const CandidateBatchConfig m_config;
+	Send m_send;
+	std::string m_pending;
+	bool m_flush_scheduled = false;
+	bool m_closed = false;
+	std::mutex m_mutex;
+};
+
+// Calls on_candidate for each line of a batch and on_done if it carries the end marker
+void for_each_candidate(const std::string& batch, const std::function<void(const std::string&)>& on_candidate,
+	const std::function<void()>& on_done);
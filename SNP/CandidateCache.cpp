@@ -0,0 +1,146 @@
+#include "CandidateCache.h"
+#include <sstream>
+
+CandidateCache& CandidateCache::instance() {
+	static CandidateCache cache;
+	return cache;
+}
+
+CandidateCache::~CandidateCache() {
+	m_resolver.request_stop();
+	m_lookup_cv.notify_all();
+}
+
+void CandidateCache::configure(const CandidateCacheConfig& config, bool shared_socket) {
+	std::lock_guard lock{m_mutex};
+	m_config = config;
+	m_shared_socket = shared_socket;
+}
+
+struct CandidateLine {
+	std::string address;
+	std::string port;
+	std::string type;
+};
+
+// a=candidate:<foundation> <component> <transport> <priority> <address> <port> typ <type> ...
+static std::optional<CandidateLine> parse_candidate(const std::string& sdp) {
+	std::istringstream stream{sdp};
+	std::string foundation, component, transport, priority, typ;
+	CandidateLine line;
+	if (!(stream >> foundation >> component >> transport >> priority >> line.address >> line.port >> typ >> line.type)) {
+		return std::nullopt;
+	}
+	return line;
+}
+
+// Foundations are numbered per agent, so the same candidate may come with a different one
+bool CandidateCache::same_endpoint(const std::string& sdp, const std::string& other) {
+	const auto a = parse_candidate(sdp);
+	const auto b = parse_candidate(other);
+	return a && b && a->address == b->address && a->port == b->port && a->type == b->type;
+}
+
+static std::string lookup(const std::string& host, u16 port) {
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* result = nullptr;
+	if (const auto error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result)) {
+		spdlog::warn("Could not resolve {}: {}", host, gai_strerror(error));
+		return "";
+	}
+
+	char address[INET6_ADDRSTRLEN]{};
+	if (result->ai_family == AF_INET) {
+		inet_ntop(AF_INET, &((sockaddr_in*)result->ai_addr)->sin_addr, address, sizeof(address));
+	} else if (result->ai_family == AF_INET6) {
+		inet_ntop(AF_INET6, &((sockaddr_in6*)result->ai_addr)->sin6_addr, address, sizeof(address));
+	}
+	freeaddrinfo(result);
+	return address;
+}
+
+std::string CandidateCache::resolve(const std::string& host, u16 port) {
+	std::lock_guard lock{m_mutex};
+	if (!m_config.enabled || host.empty()) {
+		return host;
+	}
+
+	auto& entry = m_hosts[host];
+	const auto now = std::chrono::steady_clock::now();
+	const bool fresh = !entry.address.empty() && now - entry.resolved < std::chrono::seconds{m_config.ttl_s};
+	if (!fresh && !entry.pending) {
+		// Agents are created under the manager's lock, so the lookup must not block here
+		entry.pending = true;
+		m_lookups.emplace_back(host, port);
+		if (!m_resolver.joinable()) {
+			m_resolver = std::jthread{[this](std::stop_token stop) { run_resolver(stop); }};
+		}
+		m_lookup_cv.notify_one();
+	}
+	return entry.address.empty() ? host : entry.address;
+}
+
+void CandidateCache::run_resolver(std::stop_token stop) {
+	std::unique_lock lock{m_mutex};
+	while (m_lookup_cv.wait(lock, stop, [this] { return !m_lookups.empty(); })) {
+		const auto [host, port] = std::move(m_lookups.front());
+		m_lookups.pop_front();
+		lock.unlock();
+		auto address = lookup(host, port);
+		lock.lock();
+
+		auto& entry = m_hosts[host];
+		entry.pending = false;
+		if (!address.empty()) {
+			spdlog::debug("Cached {} as {}", host, address);
+			entry.address = std::move(address);
+			entry.resolved = std::chrono::steady_clock::now();
+		}
+	}
+}
+
+void CandidateCache::on_local_candidate(const char* sdp) {
+	const auto candidate = parse_candidate(sdp);
+	if (!candidate || candidate->type != "srflx") {
+		return;
+	}
+
+	std::lock_guard lock{m_mutex};
+	if (!m_public_address.empty() && candidate->address != m_public_address) {
+		spdlog::info("Public address changed from {} to {}, dropping cached server addresses", m_public_address, candidate->address);
+		m_hosts.clear();
+	}
+	m_public_address = candidate->address;
+	if (m_shared_socket) {
+		m_reflexive_candidate = sdp;
+		m_reflexive_seen = std::chrono::steady_clock::now();
+	}
+}
+
+std::string CandidateCache::reusable_candidate() {
+	std::lock_guard lock{m_mutex};
+	// The NAT may drop an idle mapping, a stale candidate would only send the peer's checks nowhere
+	const auto age = std::chrono::steady_clock::now() - m_reflexive_seen;
+	if (!m_config.enabled || !m_shared_socket || age >= std::chrono::seconds{m_config.candidate_ttl_s}) {
+		return "";
+	}
+	return m_reflexive_candidate;
+}
+
+void CandidateCache::on_gathering_done(const NetAddress& peer, std::chrono::nanoseconds duration) {
+	std::lock_guard lock{m_mutex};
+	m_gatherings++;
+	m_gathering_total += duration;
+	spdlog::debug("Gathered candidates for {} in {:.1f} ms, average {:.1f} ms over {} agents", peer.b64(),
+		std::chrono::duration<f64, std::milli>{duration}.count(),
+		std::chrono::duration<f64, std::milli>{m_gathering_total}.count() / m_gatherings, m_gatherings);
+}
+
+void CandidateCache::invalidate() {
+	std::lock_guard lock{m_mutex};
+	m_hosts.clear();
+	m_public_address.clear();
+	m_reflexive_candidate.clear();
+}
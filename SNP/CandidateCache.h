@@ -0,0 +1,61 @@
+#pragma once
+#include "Common.h"
+#include <deque>
+#include <thread>
+#include <condition_variable>
+
+struct CandidateCacheConfig {
+	bool enabled = false;
+	u32 ttl_s = 600; // resolved STUN/TURN addresses are looked up again after this
+	u32 candidate_ttl_s = 60; // in mux mode, how long a server reflexive candidate is handed to new agents
+};
+
+// Shares what every agent would otherwise find out again on its own. The lookup of the STUN and
+// TURN servers is cached as numeric addresses. In mux mode all agents share one socket, so they
+// all get the same server reflexive candidate and a new agent signals the last one seen right
+// away instead of waiting for its own STUN round trip. With a socket per agent that candidate
+// belongs to one agent only, and relay candidates always belong to one TURN allocation.
+// Our public address, taken from the server reflexive candidates, tells when the network
+// changed, and then the cache is dropped.
+class CandidateCache {
+public:
+	static CandidateCache& instance();
+	~CandidateCache();
+
+	void configure(const CandidateCacheConfig& config, bool shared_socket);
+	// Returns the cached numeric address, or host itself while it is being looked up
+	std::string resolve(const std::string& host, u16 port);
+	void on_local_candidate(const char* sdp);
+	// The server reflexive candidate of the shared socket while it is fresh, otherwise empty
+	std::string reusable_candidate();
+	static bool same_endpoint(const std::string& sdp, const std::string& other);
+	void on_gathering_done(const NetAddress& peer, std::chrono::nanoseconds duration);
+	void invalidate();
+
+private:
+	CandidateCache() = default;
+	void run_resolver(std::stop_token stop);
+
+	struct Entry {
+		std::string address;
+		std::chrono::steady_clock::time_point resolved;
+		bool pending = false;
+	};
+
+private:
+	CandidateCacheConfig m_config;
+	std::unordered_map<std::string, Entry> m_hosts;
+	bool m_shared_socket = false;
+	std::string m_public_address;
+	std::string m_reflexive_candidate;
+	std::chrono::steady_clock::time_point m_reflexive_seen;
+	u64 m_gatherings = 0;
+	std::chrono::nanoseconds m_gathering_total{};
+	std::mutex m_mutex;
+
+	// getaddrinfo can block for seconds, so lookups get their own thread instead of the task
+	// thread that paces game traffic. Only started once the first lookup is needed.
+	std::deque<std::pair<std::string, u16>> m_lookups;
+	std::condition_variable_any m_lookup_cv;
+	std::jthread m_resolver;
+};
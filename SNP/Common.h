@@ -1,25 +1,16 @@
 #pragma once
 
-#include "../shared_common.h"
+#include "Platform.h"
 
 #define JSON_DIAGNOSTICS 1
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <winsock2.h>
-#include <ws2tcpip.h>
-
 #include <juice.h>
 #include <base64.hpp>
 #include <concurrentqueue.h>
 #include <json.hpp>
 using Json = nlohmann::json;
 
-inline const fs::path g_starcraft_dir = [] {
-	wchar_t buffer[MAX_PATH];
-	GetModuleFileNameW(0, buffer, MAX_PATH);
-	return fs::path{buffer}.parent_path();
-}();
+inline const fs::path g_starcraft_dir = platform::executable_dir();
 
 #include "spdlog/spdlog.h"
 #include "spdlog/async.h"
@@ -28,6 +19,8 @@ inline const fs::path g_starcraft_dir = [] {
 #include "spdlog/fmt/bin_to_hex.h"
 
 #include "../NetShared/StormTypes.h"
+#include "../NetShared/StormPacket.h"
+#include "../NetShared/AdFormat.h"
 #include "SNPModule.h"
 
 inline std::string to_string(juice_state value) {
@@ -48,7 +41,7 @@ inline std::string as_string(const auto& value) {
 		return value;
 	} else if constexpr (requires { to_string(value); }) {
 		return to_string(value);
-	} else if constexpr (requires { std::declval(std::stringstream) << value; }) {
+	} else if constexpr (requires { std::declval<std::stringstream&>() << value; }) {
 		std::stringstream ss;
 		ss << value;
 		return ss.str();
@@ -0,0 +1,147 @@
+#include "Compression.h"
+#include <array>
+
+namespace compression {
+
+// Patterns taken from captured Storm traffic (see SC Networking.md), most common last so they sit closest to the data
+static constexpr char DICTIONARY[] =
+	"(2)" "(3)" "(4)" "(5)" "(6)" "(7)" "(8)" " 1.1.scx" ".scm" "\x00" "Maps\\" "Download\\"
+	",44,,3,,1e,,1,cb2edaab,1,," ",33,,3,,1e,,1,cb2edaab,5,," "\r" "Status" "\r"
+	"\x3e" "\x07" "\xff" "\x06" "\x02" "\x04" "\x3e" "\x06" "\xff" "\x06" "\x02" "\x04" "\x3e" "\x00" "\xff" "\x06" "\x06" "\x01"
+	"\x06\x06\x06\x06\x06\x06\x06\x06" "\x00\x00\x00\x00" "\x02\x02\x02\x02\x02\x02" "\x04\x04\x04\x04\x04\x04" "\x01\x01"
+	"\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\x01\x00\x00\x00" "\x08\x00\x00\x00" "\x16\x00\x00\x00" "\x04\x00\x00\x00" "\x05\x00\x00\x00"
+	"\x37\x01" "\x64\x95\x00\x70\x22\x63\x02\x02\x00\x00\x88\x0e\x00\x00\x00\x00\x00\x63\x02\x02\x00\x00\x88\x0e"
+	"\x02\x00\x00\x00" "\x02\x00\x01\x00" "\x01\x00\x00\x00\x00\x00\x00\x00"
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+
+static constexpr size_t DICTIONARY_SIZE = sizeof(DICTIONARY) - 1;
+static constexpr size_t MAX_SOURCE_SIZE = 1024;
+static constexpr size_t MIN_MATCH = 3;
+static constexpr size_t MAX_MATCH = 0x7f + MIN_MATCH;
+static constexpr size_t MAX_LITERALS = 0x80;
+static constexpr u32 HASH_BITS = 12;
+static constexpr u16 EMPTY = 0xffff;
+
+using HashTable = std::array<u16, 1 << HASH_BITS>;
+
+static u32 hash(const u8* bytes) {
+	const u32 value = bytes[0] | bytes[1] << 8 | bytes[2] << 16;
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static const HashTable& dictionary_table() {
+	static const HashTable table = [] {
+		HashTable result;
+		result.fill(EMPTY);
+		for (size_t i = 0; i + MIN_MATCH <= DICTIONARY_SIZE; i++) {
+			result[hash((const u8*)DICTIONARY + i)] = (u16)i;
+		}
+		return result;
+	}();
+	return table;
+}
+
+size_t compress(const char* data, size_t size, char* out, size_t capacity) {
+	if (size == 0 || size > MAX_SOURCE_SIZE) {
+		return 0;
+	}
+
+	u8 window[DICTIONARY_SIZE + MAX_SOURCE_SIZE];
+	memcpy(window, DICTIONARY, DICTIONARY_SIZE);
+	memcpy(window + DICTIONARY_SIZE, data, size);
+	HashTable table = dictionary_table();
+
+	size_t written = 0;
+	const auto emit_literals = [&](size_t from, size_t to) {
+		while (from < to) {
+			const auto count = std::min(to - from, MAX_LITERALS);
+			if (written + 1 + count > capacity) {
+				return false;
+			}
+			out[written++] = (char)(count - 1);
+			memcpy(out + written, window + from, count);
+			written += count;
+			from += count;
+		}
+		return true;
+	};
+
+	const size_t end = DICTIONARY_SIZE + size;
+	size_t position = DICTIONARY_SIZE;
+	size_t literal_start = position;
+	while (position + MIN_MATCH <= end) {
+		auto& entry = table[hash(window + position)];
+		const size_t candidate = entry;
+		entry = (u16)position;
+
+		if (candidate == EMPTY || memcmp(window + candidate, window + position, MIN_MATCH) != 0) {
+			position++;
+			continue;
+		}
+
+		// Matches may overlap the position being coded, which turns runs of zeroes into a single match
+		size_t length = MIN_MATCH;
+		while (position + length < end && length < MAX_MATCH && window[candidate + length] == window[position + length]) {
+			length++;
+		}
+
+		if (!emit_literals(literal_start, position) || written + 3 > capacity) {
+			return 0;
+		}
+		const auto distance = (u16)(position - candidate);
+		out[written++] = (char)(0x80 | (length - MIN_MATCH));
+		out[written++] = (char)(distance & 0xff);
+		out[written++] = (char)(distance >> 8);
+		position += length;
+		literal_start = position;
+	}
+
+	if (!emit_literals(literal_start, end)) {
+		return 0;
+	}
+	return written;
+}
+
+size_t decompress(const char* data, size_t size, char* out, size_t capacity) {
+	capacity = std::min(capacity, MAX_SOURCE_SIZE);
+	u8 window[DICTIONARY_SIZE + MAX_SOURCE_SIZE];
+	memcpy(window, DICTIONARY, DICTIONARY_SIZE);
+
+	const auto input = (const u8*)data;
+	size_t read = 0;
+	size_t position = DICTIONARY_SIZE;
+	const size_t end = DICTIONARY_SIZE + capacity;
+	while (read < size) {
+		const u8 control = input[read++];
+		if (control < 0x80) {
+			const size_t count = control + 1;
+			if (read + count > size || position + count > end) {
+				return 0;
+			}
+			memcpy(window + position, input + read, count);
+			read += count;
+			position += count;
+		} else {
+			const size_t length = control - 0x80 + MIN_MATCH;
+			if (read + 2 > size) {
+				return 0;
+			}
+			const size_t distance = input[read] | input[read + 1] << 8;
+			read += 2;
+			if (distance == 0 || distance > position || position + length > end) {
+				return 0;
+			}
+			for (size_t i = 0; i < length; i++, position++) {
+				window[position] = window[position - distance];
+			}
+		}
+	}
+
+	const auto produced = position - DICTIONARY_SIZE;
+	memcpy(out, window + DICTIONARY_SIZE, produced);
+	return produced;
+}
+
+}
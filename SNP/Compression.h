@@ -0,0 +1,22 @@
+#pragma once
+#include "Common.h"
+
+struct CompressionConfig {
+	bool enabled = false;
+	u32 min_size = 32; // smaller packets are never worth trying
+};
+
+// Small LZ77 coder for single Storm packets. Both sides prime the window with a fixed dictionary
+// of byte patterns common in Storm traffic (zero padding, headers, stat strings, map names), so
+// even a lone 40 byte turn packet has something to match against.
+//
+// Stream format: a control byte 0x00-0x7f is followed by (c + 1) literal bytes,
+// 0x80-0xff is a match of (c - 0x80 + 3) bytes at a little endian u16 distance back.
+namespace compression {
+
+// Returns the compressed size, or 0 if the result would not fit in capacity
+size_t compress(const char* data, size_t size, char* out, size_t capacity);
+// Returns the decompressed size, or 0 if the input is malformed or does not fit in capacity
+size_t decompress(const char* data, size_t size, char* out, size_t capacity);
+
+}
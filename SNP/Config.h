@@ -1,5 +1,16 @@
 #pragma once
 #include "Common.h"
+#include "Impairment.h"
+#include "Fec.h"
+#include "Compression.h"
+#include "SendScheduler.h"
+#include "AckElision.h"
+#include "Multipath.h"
+#include "Forwarding.h"
+#include "Prewarm.h"
+#include "CandidateCache.h"
+#include "CandidateBatch.h"
+#include "Reorder.h"
 
 enum class LogLevel {
 	None,
@@ -11,6 +22,27 @@ enum class LogLevel {
 	Trace
 };
 
+enum class JuiceConcurrency {
+	Thread, // a socket and a thread per agent
+	Poll,   // a socket per agent, one thread polling all of them
+	Mux,    // one socket and one thread for all agents, demultiplexed by ICE credentials
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(JuiceConcurrency, {
+	{JuiceConcurrency::Thread, "thread"},
+	{JuiceConcurrency::Poll, "poll"},
+	{JuiceConcurrency::Mux, "mux"},
+})
+
+inline std::string to_string(JuiceConcurrency value) {
+	switch (value) {
+		EnumStringCase(JuiceConcurrency::Thread);
+		EnumStringCase(JuiceConcurrency::Poll);
+		EnumStringCase(JuiceConcurrency::Mux);
+	}
+	return std::to_string((s32)value);
+}
+
 struct SnpConfig {
 	std::string server = "crownlink.platypus.coffee";
 	u16 port = 9988;
@@ -23,8 +55,23 @@ struct SnpConfig {
 	std::string turn_username = "";
 	std::string turn_password = "";
 
+	JuiceConcurrency juice_concurrency = JuiceConcurrency::Thread;
+	u16 mux_port = 6112; // the shared local UDP port in mux mode
+
 	LogLevel log_level = LogLevel::Debug;
 
+	FecConfig fec;
+	CompressionConfig compression;
+	SchedulerConfig scheduler;
+	AckElisionConfig ack_elision;
+	MultipathConfig multipath;
+	ForwardingConfig forwarding;
+	PrewarmConfig prewarm;
+	CandidateCacheConfig candidate_cache;
+	CandidateBatchConfig candidate_batch;
+	ReorderConfig reorder;
+	ImpairmentConfig impairment;
+
 	static SnpConfig& instance();
 };
 
@@ -66,6 +113,91 @@ public:
 			load_field(*turn, "password", config.turn_password);
 		}
 
+		if (auto juice = section(json, "juice")) {
+			load_field(*juice, "concurrency", config.juice_concurrency);
+			load_field(*juice, "mux-port", config.mux_port);
+		}
+
+		if (auto fec = section(json, "fec")) {
+			load_field(*fec, "enabled", config.fec.enabled);
+			load_field(*fec, "group-size", config.fec.group_size);
+			load_field(*fec, "duplicate-below", config.fec.duplicate_below);
+			load_field(*fec, "enable-loss", config.fec.enable_loss);
+			load_field(*fec, "disable-loss", config.fec.disable_loss);
+		}
+
+		if (auto compression = section(json, "compression")) {
+			load_field(*compression, "enabled", config.compression.enabled);
+			load_field(*compression, "min-size", config.compression.min_size);
+		}
+
+		if (auto scheduler = section(json, "scheduler")) {
+			load_field(*scheduler, "enabled", config.scheduler.enabled);
+			load_field(*scheduler, "bulk-kbps", config.scheduler.bulk_kbps);
+			load_field(*scheduler, "min-kbps", config.scheduler.min_kbps);
+			load_field(*scheduler, "max-kbps", config.scheduler.max_kbps);
+			load_field(*scheduler, "max-queue-ms", config.scheduler.max_queue_ms);
+		}
+
+		if (auto ack_elision = section(json, "ack-elision")) {
+			load_field(*ack_elision, "enabled", config.ack_elision.enabled);
+			load_field(*ack_elision, "window-ms", config.ack_elision.window_ms);
+		}
+
+		if (auto multipath = section(json, "multipath")) {
+			load_field(*multipath, "enabled", config.multipath.enabled);
+			load_field(*multipath, "mode", config.multipath.mode);
+			load_field(*multipath, "probe-interval-ms", config.multipath.probe_interval_ms);
+			load_field(*multipath, "switch-margin-ms", config.multipath.switch_margin_ms);
+		}
+
+		if (auto forwarding = section(json, "forwarding")) {
+			load_field(*forwarding, "enabled", config.forwarding.enabled);
+			load_field(*forwarding, "report-interval-ms", config.forwarding.report_interval_ms);
+		}
+
+		if (auto prewarm = section(json, "prewarm")) {
+			load_field(*prewarm, "enabled", config.prewarm.enabled);
+			load_field(*prewarm, "max-sessions", config.prewarm.max_sessions);
+			load_field(*prewarm, "ad-timeout-ms", config.prewarm.ad_timeout_ms);
+		}
+
+		if (auto candidate_cache = section(json, "candidate-cache")) {
+			load_field(*candidate_cache, "enabled", config.candidate_cache.enabled);
+			load_field(*candidate_cache, "ttl-s", config.candidate_cache.ttl_s);
+			load_field(*candidate_cache, "candidate-ttl-s", config.candidate_cache.candidate_ttl_s);
+		}
+
+		if (auto candidate_batch = section(json, "candidate-batch")) {
+			load_field(*candidate_batch, "enabled", config.candidate_batch.enabled);
+			load_field(*candidate_batch, "window-ms", config.candidate_batch.window_ms);
+		}
+
+		if (auto reorder = section(json, "reorder")) {
+			load_field(*reorder, "enabled", config.reorder.enabled);
+			load_field(*reorder, "hold-ms", config.reorder.hold_ms);
+			load_field(*reorder, "max-depth", config.reorder.max_depth);
+			load_field(*reorder, "duplicate-window-ms", config.reorder.duplicate_window_ms);
+		}
+
+		if (auto impairment = section(json, "impairment")) {
+			load_field(*impairment, "enabled", config.impairment.enabled);
+			load_field(*impairment, "outbound", config.impairment.outbound);
+			load_field(*impairment, "inbound", config.impairment.inbound);
+			load_field(*impairment, "delay-ms", config.impairment.delay_ms);
+			load_field(*impairment, "jitter-ms", config.impairment.jitter_ms);
+			load_field(*impairment, "distribution", config.impairment.distribution);
+			load_field(*impairment, "loss", config.impairment.loss);
+			load_field(*impairment, "duplicate", config.impairment.duplicate);
+			load_field(*impairment, "reorder", config.impairment.reorder);
+			load_field(*impairment, "reorder-ms", config.impairment.reorder_ms);
+			load_field(*impairment, "bandwidth-kbps", config.impairment.bandwidth_kbps);
+			load_field(*impairment, "queue-ms", config.impairment.queue_ms);
+		}
+		if (config.impairment.enabled) {
+			spdlog::warn("Network impairment is enabled, this is for testing only");
+		}
+
 		load_field(json, "log-level", config.log_level);
 		switch (config.log_level) {
 			case LogLevel::Trace: {
@@ -113,6 +245,76 @@ public:
 				{"username", config.turn_username},
 				{"password", config.turn_password},
 			}},
+			{"juice", {
+				{"concurrency", config.juice_concurrency},
+				{"mux-port", config.mux_port},
+			}},
+			{"fec", {
+				{"enabled", config.fec.enabled},
+				{"group-size", config.fec.group_size},
+				{"duplicate-below", config.fec.duplicate_below},
+				{"enable-loss", config.fec.enable_loss},
+				{"disable-loss", config.fec.disable_loss},
+			}},
+			{"compression", {
+				{"enabled", config.compression.enabled},
+				{"min-size", config.compression.min_size},
+			}},
+			{"scheduler", {
+				{"enabled", config.scheduler.enabled},
+				{"bulk-kbps", config.scheduler.bulk_kbps},
+				{"min-kbps", config.scheduler.min_kbps},
+				{"max-kbps", config.scheduler.max_kbps},
+				{"max-queue-ms", config.scheduler.max_queue_ms},
+			}},
+			{"ack-elision", {
+				{"enabled", config.ack_elision.enabled},
+				{"window-ms", config.ack_elision.window_ms},
+			}},
+			{"multipath", {
+				{"enabled", config.multipath.enabled},
+				{"mode", config.multipath.mode},
+				{"probe-interval-ms", config.multipath.probe_interval_ms},
+				{"switch-margin-ms", config.multipath.switch_margin_ms},
+			}},
+			{"forwarding", {
+				{"enabled", config.forwarding.enabled},
+				{"report-interval-ms", config.forwarding.report_interval_ms},
+			}},
+			{"prewarm", {
+				{"enabled", config.prewarm.enabled},
+				{"max-sessions", config.prewarm.max_sessions},
+				{"ad-timeout-ms", config.prewarm.ad_timeout_ms},
+			}},
+			{"candidate-cache", {
+				{"enabled", config.candidate_cache.enabled},
+				{"ttl-s", config.candidate_cache.ttl_s},
+				{"candidate-ttl-s", config.candidate_cache.candidate_ttl_s},
+			}},
+			{"candidate-batch", {
+				{"enabled", config.candidate_batch.enabled},
+				{"window-ms", config.candidate_batch.window_ms},
+			}},
+			{"reorder", {
+				{"enabled", config.reorder.enabled},
+				{"hold-ms", config.reorder.hold_ms},
+				{"max-depth", config.reorder.max_depth},
+				{"duplicate-window-ms", config.reorder.duplicate_window_ms},
+			}},
+			{"impairment", {
+				{"enabled", config.impairment.enabled},
+				{"outbound", config.impairment.outbound},
+				{"inbound", config.impairment.inbound},
+				{"delay-ms", config.impairment.delay_ms},
+				{"jitter-ms", config.impairment.jitter_ms},
+				{"distribution", config.impairment.distribution},
+				{"loss", config.impairment.loss},
+				{"duplicate", config.impairment.duplicate},
+				{"reorder", config.impairment.reorder},
+				{"reorder-ms", config.impairment.reorder_ms},
+				{"bandwidth-kbps", config.impairment.bandwidth_kbps},
+				{"queue-ms", config.impairment.queue_ms},
+			}},
 			{"log-level", config.log_level},
 		};
 
@@ -2,15 +2,27 @@
 
 #define BUFFER_SIZE 4096
 constexpr auto ADDRESS_SIZE = 16;
+constexpr auto MAX_TIMER_WAIT = 1s;
+constexpr auto SOLICITOR_TIMEOUT = 10s;
+constexpr auto METRICS_INTERVAL = 5min;
 
 CrownLink::CrownLink() {
 	spdlog::info("Initializing, version {}", CL_VERSION);
 	m_is_running = true;
+	const auto& config = SnpConfig::instance();
+	CandidateCache::instance().configure(config.candidate_cache, config.juice_concurrency == JuiceConcurrency::Mux);
+	m_timers.set_wakeup([this] { m_signaling_socket.wake(); });
+	schedule_metrics_log();
 	m_signaling_thread = std::jthread{&CrownLink::receive_signaling, this};
 }
 
 CrownLink::~CrownLink() {   
 	spdlog::info("Shutting down");
+	send_bye();
+	PipelineMetrics::instance().log();
+	if (m_last_browse != std::chrono::steady_clock::time_point{}) {
+		log_browse_session();
+	}
 	m_is_running = false;
 	m_signaling_socket.echo(""); // wakes up m_signaling_thread so it can close
 	m_signaling_socket.deinit();
@@ -20,6 +32,7 @@ CrownLink::~CrownLink() {
 
 void CrownLink::request_advertisements() {
 	spdlog::debug("Requesting lobbies");
+	track_browse_session();
 	m_signaling_socket.request_advertisers();
 
 	switch (m_signaling_socket.state()) {
@@ -36,12 +49,26 @@ void CrownLink::request_advertisements() {
 		} break;
 	}
 
+	const bool prewarm = SnpConfig::instance().prewarm.enabled;
 	std::lock_guard lock{g_advertisement_mutex};
 	for (const auto& advertiser : m_known_advertisers) {
-		auto status = m_juice_manager.agent_state(advertiser);
-		m_juice_manager.send_signal_ping(advertiser);
-		spdlog::trace("Requesting game state from {}", base64::to_base64(std::string{(char*)advertiser.bytes, sizeof(NetAddress)}));
-		m_signaling_socket.send_packet(advertiser, SignalMessageType::SolicitAds);
+		// A ping makes the host start ICE with us, only lobbies chosen for prewarming get one
+		if (prewarm && m_prewarm.is_selected(advertiser)) {
+			m_juice_manager.send_signal_ping(advertiser);
+		}
+		m_prewarm.on_solicit(advertiser);
+		spdlog::trace("Requesting game state from {}", advertiser.b64());
+		// Older hosts ignore the data and keep replying with a raw AdFile
+		m_signaling_socket.send_packet(advertiser, SignalMessageType::SolicitAds, std::to_string(ad_format::AD_FORMAT_VERSION));
+	}
+	if (prewarm) {
+		retire_dropped_prewarms();
+	}
+}
+
+void CrownLink::retire_dropped_prewarms() {
+	for (const auto& host : m_prewarm.take_dropped()) {
+		m_juice_manager.retire_prewarmed(host);
 	}
 }
 
@@ -54,7 +81,11 @@ void CrownLink::receive_signaling() {
 
 	std::vector<SignalPacket> incoming_packets;
 	while (m_is_running) {
-		m_juice_manager.clear_inactive_agents();
+		// Timers scheduled from other threads that are due sooner wake the wait up
+		const auto wait = m_timers.advance(MAX_TIMER_WAIT);
+		if (!m_signaling_socket.wait_for_data(std::chrono::ceil<std::chrono::milliseconds>(wait))) {
+			continue;
+		}
 		auto bytes = m_signaling_socket.receive_packets(incoming_packets);
 		if (!m_is_running) return;
 		if (bytes > 0) {
@@ -75,7 +106,7 @@ void CrownLink::handle_signal_packets(std::vector<SignalPacket>& packets) {
 					m_signaling_socket.start_advertising();
 				}
 			} else {
-				m_client_id = base64::from_base64(packet.data);
+				m_client_id = fast_base64::from_base64(packet.data);
 				spdlog::info("received client ID from server: {}", m_client_id.b64());
 				m_client_id_set = true;
 			}
@@ -86,10 +117,15 @@ void CrownLink::handle_signal_packets(std::vector<SignalPacket>& packets) {
 		case SignalMessageType::SolicitAds: {
 			if (m_is_advertising) {
 				spdlog::debug("received solicitation from {}, replying with our lobby info", packet.peer_address.b64());
+				track_solicitor(packet.peer_address);
 				std::string send_buffer;
-				send_buffer.append((const char*) & m_ad_data, sizeof(AdFile));
+				if (packet.data == std::to_string(ad_format::AD_FORMAT_VERSION)) {
+					send_buffer = ad_format::encode(m_ad_data);
+				} else {
+					send_buffer.append((const char*)&m_ad_data, sizeof(AdFile));
+				}
 				m_signaling_socket.send_packet(packet.peer_address, SignalMessageType::GameAd,
-					base64::to_base64(send_buffer));
+					fast_base64::to_base64(send_buffer));
 			}
 		} break;
 		case SignalMessageType::GameAd: {
@@ -97,16 +133,28 @@ void CrownLink::handle_signal_packets(std::vector<SignalPacket>& packets) {
 			// Give the ad to storm
 			spdlog::debug("received lobby info from {}", packet.peer_address.b64());
 			
-			auto decoded_data = base64::from_base64(packet.data);
+			// Either format fits well within twice a raw AdFile, anything longer is malformed
+			char decoded_data[2 * sizeof(AdFile)];
+			const auto decoded_size = fast_base64::decode(packet.data, decoded_data, sizeof(decoded_data));
 			AdFile ad{};
-			memcpy_s(&ad, sizeof(ad), decoded_data.c_str(), sizeof(ad));
+			if (!decoded_size || !ad_format::decode(std::string_view{decoded_data, decoded_size}, ad)) {
+				spdlog::warn("dropping malformed lobby info from {}", packet.peer_address.b64());
+				break;
+			}
 			snp::pass_advertisement(packet.peer_address, ad);
 
-			if (ad.game_info.game_state != 12) { // 12 = game in progress
+			// Browsing only needs the ad, an ICE agent is created once we join, host or prewarm this lobby
+			const bool warm = m_prewarm.on_ad(packet.peer_address, ad);
+			if (!SnpConfig::instance().prewarm.enabled || !warm) {
+				spdlog::trace("not starting ICE with {} while browsing", packet.peer_address.b64());
+			} else if (ad.game_info.game_state != 12) { // 12 = game in progress
 				m_juice_manager.mark_last_signal(packet.peer_address);
 			} else {
 				spdlog::debug("skipped updating signal because game is in progress");
 			}
+			if (SnpConfig::instance().prewarm.enabled) {
+				retire_dropped_prewarms();
+			}
 
 			NetAddress& netaddress = (NetAddress&)ad.game_info.host;
 			spdlog::debug("Game Info Received:\n"
@@ -130,11 +178,19 @@ void CrownLink::handle_signal_packets(std::vector<SignalPacket>& packets) {
 				ad.game_info.version_id
 			);
 		} break;
+		case SignalMessageType::PeerBye: {
+			handle_bye(packet.peer_address);
+		} break;
 		case SignalMessageType::SignalingPing:
 		case SignalMessageType::JuiceTurnCredentials:
 		case SignalMessageType::JuiceLocalDescription:
 		case SignalMessageType::JuciceCandidate:
-		case SignalMessageType::JuiceDone: {
+		case SignalMessageType::JuiceDone:
+		case SignalMessageType::JuiceRelayDescription:
+		case SignalMessageType::JuiceRelayCandidate:
+		case SignalMessageType::JuiceRelayDone:
+		case SignalMessageType::JuiceCandidateBatch:
+		case SignalMessageType::JuiceRelayCandidateBatch: {
 			m_juice_manager.handle_signal_packet(packet);
 		} break;
 		}
@@ -148,9 +204,11 @@ void CrownLink::handle_winsock_error(s32 error_code) {
 		spdlog::error("Connection to server closed, attempting reconnect");
 	} else {
 		spdlog::dump_backtrace();
-		spdlog::error("Winsock error {} received, attempting reconnect", WSAGetLastError());
+		spdlog::error("Winsock error {} received, attempting reconnect", platform::last_socket_error());
 	}
 
+	// Losing the server usually means the network changed under us
+	CandidateCache::instance().invalidate();
 	while (true) {
 		m_signaling_socket.deinit();
 		if (m_signaling_socket.try_init()) {
@@ -165,21 +223,79 @@ void CrownLink::update_known_advertisers(const std::string& data) {
 	m_known_advertisers.clear();
 	// SNETADDR in base64 encoding is always 24 characters
 	spdlog::trace("Data received: {}", data);
-	for (size_t i = 0; (i + 1) * 24 < data.size() + 1; i++) {
-		try {
-			const auto peer_str = base64::from_base64(data.substr(i*24, 24));
-			spdlog::debug("Potential lobby owner received: {}", data.substr(i*24, 24));
-			m_known_advertisers.push_back(NetAddress{peer_str});
-
-			std::lock_guard lock{m_juice_manager.mutex()};
-			m_juice_manager.ensure_agent(peer_str, lock);
-		} catch (const std::exception &exc) {
+	const std::string_view ids{data};
+	for (size_t i = 0; i + fast_base64::ADDRESS_CHARS <= ids.size(); i += fast_base64::ADDRESS_CHARS) {
+		const auto id = ids.substr(i, fast_base64::ADDRESS_CHARS);
+		NetAddress peer;
+		if (!fast_base64::decode_address(id, peer.bytes)) {
 			spdlog::dump_backtrace();
-			spdlog::error("Processing: {} error: {}", data.substr(i,24), exc.what());
+			spdlog::error("Processing: {} error: not a peer ID", id);
+			continue;
 		}
+		spdlog::debug("Potential lobby owner received: {}", id);
+		m_known_advertisers.push_back(peer);
 	}
 }
 
+// Browsing asks for the lobby list every few seconds, a longer gap ends the session
+void CrownLink::track_browse_session() {
+	const auto now = std::chrono::steady_clock::now();
+	if (now - m_last_browse > 10s) {
+		if (m_last_browse != std::chrono::steady_clock::time_point{}) {
+			log_browse_session();
+		}
+		m_browse_agents_start = m_juice_manager.agents_created();
+		m_browse_lobbies = 0;
+	}
+	m_last_browse = now;
+	std::lock_guard lock{g_advertisement_mutex};
+	m_browse_lobbies = std::max<u64>(m_browse_lobbies, m_known_advertisers.size());
+}
+
+void CrownLink::log_browse_session() {
+	spdlog::info("Browse session ended, up to {} lobbies listed, {} ICE agents created", m_browse_lobbies,
+		m_juice_manager.agents_created() - m_browse_agents_start);
+}
+
+void CrownLink::schedule_metrics_log() {
+	m_timers.schedule(METRICS_INTERVAL, [this] {
+		PipelineMetrics::instance().log();
+		schedule_metrics_log();
+	});
+}
+
+void CrownLink::track_solicitor(const NetAddress& peer) {
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard lock{m_solicitors_mutex};
+	std::erase_if(m_solicitors, [now](const auto& entry) { return now - entry.second > SOLICITOR_TIMEOUT; });
+	m_solicitors[peer] = now;
+}
+
+// Sent right away rather than posted, the signaling socket closes right after
+void CrownLink::send_bye() {
+	auto peers = m_juice_manager.send_bye();
+	{
+		std::lock_guard lock{m_solicitors_mutex};
+		for (const auto& [peer, _] : m_solicitors) {
+			if (std::find(peers.begin(), peers.end(), peer) == peers.end()) {
+				peers.push_back(peer);
+			}
+		}
+	}
+	if (m_signaling_socket.state() != SocketState::Ready) {
+		return;
+	}
+	for (const auto& peer : peers) {
+		m_signaling_socket.send_packet(peer, SignalMessageType::PeerBye);
+	}
+	spdlog::info("Said bye to {} peers", peers.size());
+}
+
+void CrownLink::handle_bye(const NetAddress& peer) {
+	m_juice_manager.disconnect(peer);
+	snp::remove_advertisement(peer);
+}
+
 void CrownLink::start_advertising(AdFile ad_data) {
 	m_ad_data = ad_data;
 	m_is_advertising = true;
@@ -191,4 +307,25 @@ void CrownLink::stop_advertising() {
 	m_is_advertising = false;
 	m_signaling_socket.stop_advertising();
 	spdlog::info("Stopped advertising lobby");
+	say_bye_to_browsers();
+}
+
+// Browsers drop the lobby from their list right away, players already in the game are left alone
+void CrownLink::say_bye_to_browsers() {
+	std::vector<NetAddress> solicitors;
+	{
+		std::lock_guard lock{m_solicitors_mutex};
+		for (const auto& [peer, _] : m_solicitors) {
+			solicitors.push_back(peer);
+		}
+		m_solicitors.clear();
+	}
+	u32 count = 0;
+	for (const auto& peer : solicitors) {
+		if (!m_juice_manager.has_game_traffic(peer)) {
+			m_signaling_socket.post_packet(peer, SignalMessageType::PeerBye);
+			count++;
+		}
+	}
+	spdlog::info("Said bye to {} browsers", count);
 }
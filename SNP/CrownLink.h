@@ -5,7 +5,10 @@
 #include <thread>
 #include <chrono>
 
-#include "signaling.h"
+#include "Signaling.h"
+#include "Prewarm.h"
+#include "TimerWheel.h"
+#include "ReceiveQueue.h"
 
 inline snp::NetworkInfo g_network_info{
 	(char*)"CrownLink",
@@ -16,6 +19,8 @@ inline snp::NetworkInfo g_network_info{
 	{sizeof(CAPS), 0x20000003, snp::MAX_PACKET_SIZE, 16, 256, 1000, 50, 8, 2}
 };
 
+inline HANDLE g_receive_event;
+
 class CrownLink {
 public:
 	CrownLink();
@@ -31,25 +36,42 @@ public:
 
 	auto& receive_queue() { return m_receive_queue; }
 	auto& juice_manager() { return m_juice_manager; }
+	auto& timers() { return m_timers; }
 	auto& signaling_socket() { return m_signaling_socket; }
+	const NetAddress& client_id() const { return m_client_id; }
 
 	void set_mode(const CrownLinkMode& v) { m_cl_version = v; }
 	CrownLinkMode mode() const { return m_cl_version; }
 
+	// Only on the signaling thread, the peer left so its agent and lobby go away now
+	void handle_bye(const NetAddress& peer);
+
 private:
 	void receive_signaling();
 	void handle_signal_packets(std::vector<SignalPacket>& packets);
 	void handle_winsock_error(s32 error_code);
 	void update_known_advertisers(const std::string& message);
+	void track_browse_session();
+	void log_browse_session();
+	void track_solicitor(const NetAddress& peer);
+	void retire_dropped_prewarms();
+	void schedule_metrics_log();
+	void send_bye();
+	void say_bye_to_browsers();
 
 private:
-	//ThQueue<GamePacket> m_receive_queue;
-	moodycamel::ConcurrentQueue<GamePacket> m_receive_queue;
-	JuiceManager m_juice_manager;
+	ReceiveQueue m_receive_queue{[] { platform::signal_event(g_receive_event); }};
+	// Only advanced by m_signaling_thread, every timer callback runs there
+	TimerWheel m_timers;
+	JuiceManager m_juice_manager{m_timers};
 	SignalingSocket m_signaling_socket;
+	PrewarmPlanner m_prewarm{SnpConfig::instance().prewarm};
 
 	std::jthread m_signaling_thread;
 	std::vector<NetAddress> m_known_advertisers;
+	// Browsers that saw our lobby recently, they have no agent for us but should drop it from their list
+	std::unordered_map<NetAddress, std::chrono::steady_clock::time_point> m_solicitors;
+	std::mutex m_solicitors_mutex;
 	AdFile m_ad_data;
 
 	bool m_is_advertising = false;
@@ -57,10 +79,13 @@ private:
 	bool m_client_id_set = false;
 	NetAddress m_client_id;
 
+	std::chrono::steady_clock::time_point m_last_browse;
+	u64 m_browse_agents_start = 0;
+	u64 m_browse_lobbies = 0;
+
 	u32 m_ellipsis_counter = 3;
 	CrownLinkMode m_cl_version = CrownLinkMode::CLNK;
 };
 
-inline HANDLE g_receive_event;
 inline std::unique_ptr<CrownLink> g_crown_link;
 inline std::mutex g_advertisement_mutex;
@@ -65,9 +65,7 @@ static void juice_logger(juice_log_level_t log_level, const char* message) {
 }
 
 static void dll_start() {
-	WSADATA wsaData{};
-	WORD wVersionRequested = MAKEWORD(2, 2);
-	if (auto error_code = WSAStartup(wVersionRequested, &wsaData); error_code != S_OK) {
+	if (const auto error_code = platform::socket_startup()) {
 		spdlog::critical("WSAStartup failed with error {}", error_code);
 	}
 
@@ -76,7 +74,7 @@ static void dll_start() {
 }
 
 static void dll_exit() {
-	WSACleanup();
+	platform::socket_cleanup();
 }
 
 BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved) {
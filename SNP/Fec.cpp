@@ -0,0 +1,169 @@
+#include "Fec.h"
+#include <bit>
+
+FecEncoder::FecEncoder(const FecConfig& config)
+: m_config{config}, m_group_size{(u16)std::bit_floor(std::clamp(config.group_size, 2u, 8u))}, m_protecting{config.enabled && config.enable_loss <= 0} {}
+
+void FecEncoder::encode(const char* data, size_t size, const FrameSink& send) {
+	size = std::min(size, MAX_FRAME_PAYLOAD);
+	const auto sequence = m_sequence++;
+
+	char frame[MAX_FRAME_SIZE];
+	const auto frame_size = write_frame(frame, FrameType::Data, 0, sequence, data, size);
+	send(frame, frame_size);
+
+	if (!m_protecting) {
+		m_group_active = false;
+		return;
+	}
+	if (size <= m_config.duplicate_below) {
+		send(frame, frame_size);
+	}
+
+	// Groups start on multiples of the group size so both sides agree on them without extra fields
+	if (sequence % m_group_size == 0) {
+		m_group_active = true;
+		m_group_start = sequence;
+		m_group_count = 0;
+		m_parity_sizes = 0;
+		m_parity_length = 0;
+		memset(m_parity, 0, sizeof(m_parity));
+	}
+	if (!m_group_active) {
+		return;
+	}
+
+	m_parity_sizes ^= (u16)size;
+	for (size_t i = 0; i < size; i++) {
+		m_parity[i] ^= data[i];
+	}
+	m_parity_length = std::max(m_parity_length, size);
+	if (++m_group_count == m_group_size) {
+		flush_parity(send);
+	}
+}
+
+void FecEncoder::flush_parity(const FrameSink& send) {
+	char payload[sizeof(u16) + MAX_FRAME_PAYLOAD];
+	memcpy(payload, &m_parity_sizes, sizeof(u16));
+	memcpy(payload + sizeof(u16), m_parity, m_parity_length);
+
+	char frame[MAX_FRAME_SIZE];
+	const auto frame_size = write_frame(frame, FrameType::Parity, (u8)m_group_count, m_group_start, payload, sizeof(u16) + m_parity_length);
+	send(frame, frame_size);
+	m_group_active = false;
+}
+
+void FecEncoder::handle_loss_report(f64 loss) {
+	if (!m_config.enabled) {
+		return;
+	}
+	if (!m_protecting && loss >= m_config.enable_loss) {
+		m_protecting = true;
+		spdlog::info("Peer reports {:.1f}% loss, enabling forward error correction", loss * 100);
+	} else if (m_protecting && loss < m_config.disable_loss) {
+		m_protecting = false;
+		spdlog::info("Peer reports {:.1f}% loss, disabling forward error correction", loss * 100);
+	}
+}
+
+FecDecoder::Slot* FecDecoder::find(u16 sequence) {
+	if (!m_history) {
+		return nullptr;
+	}
+	auto& slot = m_history[sequence % HISTORY];
+	return slot.valid && slot.sequence == sequence ? &slot : nullptr;
+}
+
+bool FecDecoder::store(u16 sequence, const char* payload, size_t size) {
+	if (!m_history) {
+		m_history = std::make_unique<Slot[]>(HISTORY);
+	}
+	auto& slot = m_history[sequence % HISTORY];
+	if (slot.valid && slot.sequence == sequence) {
+		return false;
+	}
+	slot.valid = true;
+	slot.sequence = sequence;
+	slot.size = (u16)std::min(size, MAX_FRAME_PAYLOAD);
+	memcpy(slot.data, payload, slot.size);
+	return true;
+}
+
+void FecDecoder::on_data(const FrameHeader& header, const char* payload, size_t size, const FrameSink& deliver) {
+	std::lock_guard lock{m_mutex};
+	const auto sequence = header.sequence;
+	const bool too_old = m_started && (s16)(m_highest - sequence) >= (s16)HISTORY;
+	if (!too_old && !store(sequence, payload, size)) {
+		m_stats.duplicates++;
+		return;
+	}
+	m_stats.received++;
+
+	if (!m_started) {
+		m_started = true;
+		m_highest = sequence;
+		m_window_expected = 1;
+	} else if (const auto ahead = (s16)(sequence - m_highest); ahead > 0) {
+		m_window_expected += ahead;
+		m_highest = sequence;
+	}
+	m_window_received++;
+	if (m_window_expected >= REPORT_INTERVAL) {
+		m_loss_report = std::max(0.0, 1.0 - (f64)m_window_received / m_window_expected);
+		m_window_expected = 0;
+		m_window_received = 0;
+	}
+
+	deliver(payload, size);
+}
+
+void FecDecoder::on_parity(const FrameHeader& header, const char* payload, size_t size, const FrameSink& deliver) {
+	std::lock_guard lock{m_mutex};
+	const u16 count = header.flags;
+	if (!m_started || count == 0 || count > 8 || size < sizeof(u16)) {
+		return;
+	}
+
+	u16 rebuilt_size;
+	memcpy(&rebuilt_size, payload, sizeof(u16));
+	const auto length = std::min(size - sizeof(u16), MAX_FRAME_PAYLOAD);
+	char rebuilt[MAX_FRAME_PAYLOAD]{};
+	memcpy(rebuilt, payload + sizeof(u16), length);
+
+	u32 missing_count = 0;
+	u16 missing = 0;
+	for (u16 i = 0; i < count; i++) {
+		const u16 sequence = header.sequence + i;
+		if (auto slot = find(sequence)) {
+			rebuilt_size ^= slot->size;
+			for (size_t j = 0; j < slot->size && j < length; j++) {
+				rebuilt[j] ^= slot->data[j];
+			}
+		} else {
+			missing_count++;
+			missing = sequence;
+		}
+	}
+
+	// Either nothing to do or too much lost to rebuild, Storm's resend takes over then
+	if (missing_count != 1 || rebuilt_size > length || (s16)(m_highest - missing) >= (s16)(HISTORY - 8)) {
+		return;
+	}
+
+	store(missing, rebuilt, rebuilt_size);
+	m_stats.recovered++;
+	deliver(rebuilt, rebuilt_size);
+}
+
+std::optional<f64> FecDecoder::take_loss_report() {
+	std::lock_guard lock{m_mutex};
+	auto report = m_loss_report;
+	m_loss_report.reset();
+	return report;
+}
+
+FecStats FecDecoder::stats() {
+	std::lock_guard lock{m_mutex};
+	return m_stats;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "Common.h"
+#include "PeerProtocol.h"
+#include <functional>
+
+struct FecConfig {
+	bool enabled = false;
+	u32 group_size = 4;       // Data frames per parity frame, power of two up to 8
+	u32 duplicate_below = 0;  // while protecting, also send packets up to this size twice
+	f64 enable_loss = 0.02;   // start protecting once the peer reports this much loss
+	f64 disable_loss = 0.005; // and stop again below this
+};
+
+using FrameSink = std::function<void(const char* data, size_t size)>;
+
+// Sender side: numbers Storm packets into Data frames and, if enabled and while the peer reports
+// loss, follows every group of them with an XOR parity frame
+class FecEncoder {
+public:
+	FecEncoder(const FecConfig& config);
+
+	void encode(const char* data, size_t size, const FrameSink& send);
+	void handle_loss_report(f64 loss);
+	bool is_protecting() const { return m_protecting; }
+
+private:
+	void flush_parity(const FrameSink& send);
+
+private:
+	const FecConfig m_config;
+	u16 m_group_size;
+	std::atomic<bool> m_protecting = false;
+	u16 m_sequence = 0;
+
+	bool m_group_active = false;
+	u16 m_group_start = 0;
+	u16 m_group_count = 0;
+	u16 m_parity_sizes = 0;
+	size_t m_parity_length = 0;
+	char m_parity[MAX_FRAME_PAYLOAD]{};
+};
+
+struct FecStats {
+	u64 received = 0;
+	u64 recovered = 0;
+	u64 duplicates = 0;
+};
+
+// Receiver side: unwraps Data frames, drops duplicates, rebuilds a single missing packet per
+// parity group and measures loss to report back. Frames arrive on both paths' juice threads and
+// from the inbound impairment, so everything runs under m_mutex, deliver included.
+class FecDecoder {
+public:
+	static constexpr u16 HISTORY = 64;
+	static constexpr u16 REPORT_INTERVAL = 64;
+
+	void on_data(const FrameHeader& header, const char* payload, size_t size, const FrameSink& deliver);
+	void on_parity(const FrameHeader& header, const char* payload, size_t size, const FrameSink& deliver);
+	// Returns the loss over the last window once enough packets were seen
+	std::optional<f64> take_loss_report();
+
+	FecStats stats();
+
+private:
+	struct Slot {
+		bool valid = false;
+		u16 sequence = 0;
+		u16 size = 0;
+		char data[MAX_FRAME_PAYLOAD];
+	};
+
+	Slot* find(u16 sequence);
+	bool store(u16 sequence, const char* payload, size_t size);
+
+private:
+	std::unique_ptr<Slot[]> m_history;
+	bool m_started = false;
+	u16 m_highest = 0;
+	u32 m_window_expected = 0;
+	u32 m_window_received = 0;
+	std::optional<f64> m_loss_report;
+	FecStats m_stats;
+	std::mutex m_mutex;
+};
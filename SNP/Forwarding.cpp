@@ -0,0 +1,46 @@
+#include "Forwarding.h"
+
+size_t write_routes(char* out, const std::vector<RouteEntry>& routes) {
+	const auto count = std::min(routes.size(), MAX_ROUTES);
+	out[0] = (char)count;
+	memcpy(out + 1, routes.data(), count * sizeof(RouteEntry));
+	return 1 + count * sizeof(RouteEntry);
+}
+
+std::vector<RouteEntry> read_routes(const char* data, size_t size) {
+	if (size < 1) {
+		return {};
+	}
+	const auto count = std::min<size_t>((u8)data[0], (size - 1) / sizeof(RouteEntry));
+	std::vector<RouteEntry> routes(count);
+	memcpy(routes.data(), data + 1, count * sizeof(RouteEntry));
+	return routes;
+}
+
+bool ForwardDeduplicator::is_new(const NetAddress& origin, u16 sequence) {
+	std::lock_guard lock{m_mutex};
+	auto [it, inserted] = m_windows.try_emplace(origin);
+	auto& window = it->second;
+	if (inserted) {
+		window.highest = sequence;
+		window.seen = 1;
+		return true;
+	}
+
+	const auto ahead = (s16)(sequence - window.highest);
+	if (ahead > 0) {
+		window.seen = ahead >= 64 ? 1 : window.seen << ahead | 1;
+		window.highest = sequence;
+		return true;
+	}
+	const auto behind = (u16)-ahead;
+	if (behind >= 64) {
+		return false;
+	}
+	const auto bit = 1ull << behind;
+	if (window.seen & bit) {
+		return false;
+	}
+	window.seen |= bit;
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "Common.h"
+#include "PeerProtocol.h"
+
+struct ForwardingConfig {
+	bool enabled = false;        // route around failed pairs and relay for other peers
+	u32 report_interval_ms = 1000;
+};
+
+#pragma pack(push, 1)
+// Follows the FrameHeader of a Forward frame, the Storm packet comes after it
+struct ForwardHeader {
+	NetAddress origin;
+	NetAddress destination;
+};
+
+// One entry of a Routes frame: a peer the sender can reach directly and its RTT to it
+struct RouteEntry {
+	NetAddress peer;
+	u16 rtt_ms;
+};
+#pragma pack(pop)
+
+constexpr size_t MAX_ROUTES = (MAX_FRAME_PAYLOAD - 1) / sizeof(RouteEntry);
+
+// Writes [u8 count][entries...], returns the payload size
+size_t write_routes(char* out, const std::vector<RouteEntry>& routes);
+std::vector<RouteEntry> read_routes(const char* data, size_t size);
+
+// Drops forwarded packets that were already delivered, keyed by origin since several peers can
+// route through the same relay
+class ForwardDeduplicator {
+public:
+	bool is_new(const NetAddress& origin, u16 sequence);
+
+private:
+	struct Window {
+		u16 highest = 0;
+		u64 seen = 0; // bit i = highest - i was delivered
+	};
+
+private:
+	std::unordered_map<NetAddress, Window> m_windows;
+	std::mutex m_mutex;
+};
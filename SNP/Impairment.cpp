@@ -0,0 +1,116 @@
+#include "Impairment.h"
+
+using Clock = TaskScheduler::Clock;
+
+NetworkImpairment::NetworkImpairment(const ImpairmentConfig& config, Deliver deliver)
+: m_config{config}, m_deliver{std::move(deliver)} {}
+
+void NetworkImpairment::process(const char* data, size_t size) {
+	u32 immediate = 0;
+	{
+		std::lock_guard lock{m_mutex};
+		if (m_closed) {
+			return;
+		}
+
+		std::uniform_real_distribution<f64> chance{0.0, 1.0};
+		if (chance(m_rng) < m_config.loss) {
+			return;
+		}
+
+		const auto now = Clock::now();
+		auto departure = now;
+		if (m_config.bandwidth_kbps) {
+			m_link_free_at = std::max(m_link_free_at, now);
+			if (m_link_free_at - now > std::chrono::milliseconds{m_config.queue_ms}) {
+				return;
+			}
+			m_link_free_at += std::chrono::microseconds{size * 8000 / m_config.bandwidth_kbps};
+			departure = m_link_free_at;
+		}
+
+		const auto copies = chance(m_rng) < m_config.duplicate ? 2 : 1;
+		for (auto i = 0; i < copies; i++) {
+			auto due = departure + sample_delay();
+			if (chance(m_rng) < m_config.reorder) {
+				due += std::chrono::milliseconds{m_config.reorder_ms};
+			}
+
+			if (due <= now) {
+				immediate++;
+			} else {
+				deliver_later(due, std::string{data, size});
+			}
+		}
+		if (!immediate || !begin_delivery(lock)) {
+			return;
+		}
+	}
+
+	for (u32 i = 0; i < immediate; i++) {
+		m_deliver(data, size);
+	}
+	end_delivery();
+}
+
+void NetworkImpairment::close() {
+	std::unique_lock lock{m_mutex};
+	m_closed = true;
+	m_delivered.wait(lock, [this] { return m_deliveries == 0; });
+}
+
+bool NetworkImpairment::begin_delivery(const std::lock_guard<std::mutex>&) {
+	if (m_closed) {
+		return false;
+	}
+	m_deliveries++;
+	return true;
+}
+
+void NetworkImpairment::end_delivery() {
+	std::lock_guard lock{m_mutex};
+	if (--m_deliveries == 0) {
+		m_delivered.notify_all();
+	}
+}
+
+Clock::duration NetworkImpairment::sample_delay() {
+	const f64 delay = m_config.delay_ms;
+	const f64 jitter = m_config.jitter_ms;
+
+	f64 ms = delay;
+	if (jitter > 0) {
+		switch (m_config.distribution) {
+			case DelayDistribution::Uniform: {
+				ms = std::uniform_real_distribution<f64>{delay - jitter, delay + jitter}(m_rng);
+			} break;
+			case DelayDistribution::Normal: {
+				ms = std::normal_distribution<f64>{delay, jitter}(m_rng);
+			} break;
+			case DelayDistribution::Pareto: {
+				// Lomax with shape 3: delay is the floor and jitter the mean of the heavy tail above it
+				const auto u = std::uniform_real_distribution<f64>{1e-9, 1.0}(m_rng);
+				ms = delay + 2 * jitter * (std::pow(u, -1.0 / 3.0) - 1.0);
+			} break;
+		}
+	}
+
+	return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<f64, std::milli>{std::max(ms, 0.0)});
+}
+
+void NetworkImpairment::deliver_later(Clock::time_point due, std::string packet) {
+	TaskScheduler::instance().schedule(due, [weak = weak_from_this(), packet = std::move(packet)] {
+		auto self = weak.lock();
+		if (!self) {
+			return;
+		}
+		{
+			std::lock_guard lock{self->m_mutex};
+			if (!self->begin_delivery(lock)) {
+				return;
+			}
+		}
+		self->m_deliver(packet.data(), packet.size());
+		self->end_delivery();
+	});
+}
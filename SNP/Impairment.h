@@ -0,0 +1,76 @@
+#pragma once
+#include "Common.h"
+#include "TaskScheduler.h"
+#include <random>
+
+enum class DelayDistribution {
+	Uniform,
+	Normal,
+	Pareto
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(DelayDistribution, {
+	{DelayDistribution::Uniform, "uniform"},
+	{DelayDistribution::Normal, "normal"},
+	{DelayDistribution::Pareto, "pareto"},
+})
+
+inline std::string to_string(DelayDistribution value) {
+	switch (value) {
+		EnumStringCase(DelayDistribution::Uniform);
+		EnumStringCase(DelayDistribution::Normal);
+		EnumStringCase(DelayDistribution::Pareto);
+	}
+	return std::to_string((s32)value);
+}
+
+struct ImpairmentConfig {
+	bool enabled = false;
+	bool outbound = true;
+	bool inbound = false;
+
+	u32 delay_ms = 0;
+	u32 jitter_ms = 0;
+	DelayDistribution distribution = DelayDistribution::Uniform;
+
+	f64 loss = 0.0;
+	f64 duplicate = 0.0;
+	f64 reorder = 0.0;    // chance a packet is held back by reorder_ms so later packets overtake it
+	u32 reorder_ms = 20;
+
+	u32 bandwidth_kbps = 0; // 0 = unlimited
+	u32 queue_ms = 500;     // packets that would wait longer than this for the capped link are dropped
+};
+
+// Emulates a bad link for one peer and direction: loss, duplication, delay with jitter, reordering and a bandwidth cap
+class NetworkImpairment : public std::enable_shared_from_this<NetworkImpairment> {
+public:
+	using Deliver = std::function<void(const char* data, size_t size)>;
+
+	NetworkImpairment(const ImpairmentConfig& config, Deliver deliver);
+
+	NetworkImpairment(const NetworkImpairment&) = delete;
+	NetworkImpairment& operator=(const NetworkImpairment&) = delete;
+
+	void process(const char* data, size_t size);
+	// Stops delivering and waits for deliveries in progress, must be called before whatever deliver refers to goes away
+	void close();
+
+private:
+	TaskScheduler::Clock::duration sample_delay();
+	void deliver_later(TaskScheduler::Clock::time_point due, std::string packet);
+	// Deliveries run without m_mutex: deliver takes libjuice's connection lock, which the juice thread
+	// already holds when it calls process
+	bool begin_delivery(const std::lock_guard<std::mutex>&);
+	void end_delivery();
+
+private:
+	const ImpairmentConfig m_config;
+	Deliver m_deliver;
+	std::mt19937 m_rng{std::random_device{}()};
+	TaskScheduler::Clock::time_point m_link_free_at{};
+	bool m_closed = false;
+	u32 m_deliveries = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_delivered;
+};
@@ -5,34 +5,86 @@
 #include "CrownLink.h"
 #include <regex>
 
+// Compiled once, the candidate callbacks run on libjuice's threads and should return quickly
+static const std::regex RADMIN_CANDIDATE{".+26.\\d+.\\d+.\\d+.+"};
+
+static bool is_connected(juice_state state) {
+	return state == JUICE_STATE_CONNECTED || state == JUICE_STATE_COMPLETED;
+}
+
+static juice_concurrency_mode_t to_juice_mode(JuiceConcurrency concurrency) {
+	switch (concurrency) {
+		case JuiceConcurrency::Poll: return JUICE_CONCURRENCY_MODE_POLL;
+		case JuiceConcurrency::Mux: return JUICE_CONCURRENCY_MODE_MUX;
+		default: return JUICE_CONCURRENCY_MODE_THREAD;
+	}
+}
+
+using platform::steady_ns;
+
+// When libjuice handed the datagram being processed on this thread to us, 0 on other threads
+static thread_local s64 t_received_ns = 0;
+// The juice agent whose callback runs on this thread, libjuice holds its connection lock meanwhile
+static thread_local juice_agent_t* t_callback_agent = nullptr;
+
+struct CallbackScope {
+	CallbackScope(juice_agent_t* agent) { t_callback_agent = agent; }
+	~CallbackScope() { t_callback_agent = nullptr; }
+};
+
 JuiceAgent::JuiceAgent(const NetAddress& address, std::vector<TurnServer>& turn_servers, const std::string& init_message)
-: m_p2p_state(JUICE_STATE_DISCONNECTED), m_address{address} {
+: m_p2p_state(JUICE_STATE_DISCONNECTED), m_address{address}, m_turn_servers{turn_servers},
+  m_multipath{SnpConfig::instance().multipath}, m_path_selector{m_multipath}, m_forwarding{SnpConfig::instance().forwarding} {
 	const auto& snp_config = SnpConfig::instance();
-	juice_config_t config{
-		.concurrency_mode = JUICE_CONCURRENCY_MODE_THREAD,
-		.stun_server_host = snp_config.stun_server.c_str(),
-		.stun_server_port = snp_config.stun_port,
+	m_agent = create_juice_agent(on_state_changed, on_candidate, on_gathering_done, on_recv);
+	mark_active();
 
-		.cb_state_changed = on_state_changed,
-		.cb_candidate = on_candidate,
-		.cb_gathering_done = on_gathering_done,
-		.cb_recv = on_recv,
-		.user_ptr = this,
-	};
-	if (!turn_servers.empty()) {
-		juice_turn_server servers[5]{};
-		for (unsigned int i = 0; i < turn_servers.size() && i < 5; i++) {
-			servers[i].host = turn_servers[i].host.c_str();
-			servers[i].username = turn_servers[i].username.c_str();
-			servers[i].password = turn_servers[i].password.c_str();
-			servers[i].port = turn_servers[i].port;
-		}
-		config.turn_servers = servers;
-		config.turn_servers_count = (turn_servers.size() < 5) ? turn_servers.size() : 5;
+	if (snp_config.fec.enabled || snp_config.scheduler.enabled || m_multipath.enabled) {
+		m_fec_encoder = std::make_unique<FecEncoder>(snp_config.fec);
+	}
+	if (snp_config.ack_elision.enabled) {
+		m_ack_elision.emplace(snp_config.ack_elision);
+	}
+	if (snp_config.scheduler.enabled) {
+		m_send_scheduler = std::make_shared<SendScheduler>(snp_config.scheduler, [this](const char* data, size_t size) {
+			send_packet(data, size);
+		});
+	}
+	m_compression = snp_config.compression;
+	// Every client that knows the Compressed frame can decode it, whether it compresses itself is up to its config
+	m_local_features = PEER_FEATURE_COMPRESSION;
+	if (m_multipath.enabled) {
+		m_local_features |= PEER_FEATURE_MULTIPATH;
+	}
+	if (m_forwarding.enabled) {
+		m_local_features |= PEER_FEATURE_FORWARDING;
+	}
+	if (snp_config.reorder.enabled) {
+		m_reorder_buffer = std::make_shared<ReorderBuffer>(snp_config.reorder, [this](const char* data, size_t size, s64 received_ns) {
+			g_crown_link->receive_queue().push(GamePacket{m_address, data, size, received_ns});
+		});
+	}
+	if (snp_config.candidate_batch.enabled) {
+		m_candidate_batcher = std::make_shared<CandidateBatcher>(snp_config.candidate_batch, [this](const std::string& batch) {
+			g_crown_link->signaling_socket().post_packet(m_address, SignalMessageType::JuiceCandidateBatch, batch);
+		});
+		m_relay_candidate_batcher = std::make_shared<CandidateBatcher>(snp_config.candidate_batch, [this](const std::string& batch) {
+			g_crown_link->signaling_socket().post_packet(m_address, SignalMessageType::JuiceRelayCandidateBatch, batch);
+		});
+	}
 
+	if (const auto& impairment = snp_config.impairment; impairment.enabled) {
+		if (impairment.outbound) {
+			m_outbound_impairment = std::make_shared<NetworkImpairment>(impairment, [this](const char* data, size_t size) {
+				juice_send(m_agent, data, size);
+			});
+		}
+		if (impairment.inbound) {
+			m_inbound_impairment = std::make_shared<NetworkImpairment>(impairment, [this](const char* data, size_t size) {
+				handle_datagram(data, size);
+			});
+		}
 	}
-	m_agent = juice_create(&config);
-	mark_active();
 
 	if (!init_message.empty()) {
 		handle_signal_packet(SignalPacket{init_message});
@@ -41,33 +93,138 @@ JuiceAgent::JuiceAgent(const NetAddress& address, std::vector<TurnServer>& turn_
 }
 
 JuiceAgent::~JuiceAgent() {
-	spdlog::debug("Agent {} closed", m_address.b64());
+	const auto fec_stats = m_fec_decoder.stats();
+	spdlog::debug("Agent {} closed, frames received: {}, recovered: {}, duplicates: {}", m_address.b64(), fec_stats.received, fec_stats.recovered, fec_stats.duplicates);
+	spdlog::debug("Agent {} sent: {}; received: {}", m_address.b64(), m_sent_packets.summary(), m_received_packets.summary());
+	if (m_uncompressed_bytes) {
+		spdlog::debug("Agent {} compressed {} bytes to {}", m_address.b64(), m_uncompressed_bytes.load(), m_compressed_bytes.load());
+	}
+	if (m_ack_elision) {
+		spdlog::debug("Agent {} suppressed {} repeated acks", m_address.b64(), m_ack_elision->suppressed());
+	}
+	if (m_send_scheduler) {
+		m_send_scheduler->close();
+		const auto stats = m_send_scheduler->stats();
+		spdlog::debug("Agent {} scheduler sent {} urgent and {} bulk packets, {} delayed, {} dropped, final pace {} kbps",
+			m_address.b64(), stats.urgent, stats.bulk, stats.delayed, stats.dropped, m_send_scheduler->pace_kbps());
+	}
+	if (m_reorder_buffer) {
+		m_reorder_buffer->close();
+		const auto stats = m_reorder_buffer->stats();
+		spdlog::debug("Agent {} reorder buffer: {} in order, {} held for earlier packets, {} gaps skipped, {} late, {} duplicates dropped, max depth {}",
+			m_address.b64(), stats.in_order, stats.held, stats.gaps_skipped, stats.late, stats.duplicates, stats.max_depth);
+	}
+	if (m_candidate_batcher) {
+		m_candidate_batcher->close();
+		m_relay_candidate_batcher->close();
+	}
+	if (m_outbound_impairment) {
+		m_outbound_impairment->close();
+	}
+	if (m_inbound_impairment) {
+		m_inbound_impairment->close();
+	}
+
+	juice_agent_t* relay_agent = nullptr;
+	{
+		std::unique_lock lock{m_path_mutex};
+		relay_agent = std::exchange(m_relay_agent, nullptr);
+	}
+	if (relay_agent) {
+		spdlog::debug("Agent {} paths closed, direct rtt {:.1f} ms, relay rtt {:.1f} ms, last active {}", m_address.b64(),
+			m_path_selector.rtt_ms(PathId::Direct), m_path_selector.rtt_ms(PathId::Relay), to_string(m_path_selector.active()));
+		juice_destroy(relay_agent);
+	}
     juice_destroy(m_agent);
 }
 
+juice_agent_t* JuiceAgent::create_juice_agent(juice_cb_state_changed_t on_state, juice_cb_candidate_t on_candidate,
+	juice_cb_gathering_done_t on_done, juice_cb_recv_t on_receive) {
+	const auto& snp_config = SnpConfig::instance();
+	auto& cache = CandidateCache::instance();
+	const auto stun_server = cache.resolve(snp_config.stun_server, snp_config.stun_port);
+	std::string turn_hosts[5];
+	const bool mux = snp_config.juice_concurrency == JuiceConcurrency::Mux;
+	juice_config_t config{
+		.concurrency_mode = to_juice_mode(snp_config.juice_concurrency),
+		.stun_server_host = stun_server.empty() ? nullptr : stun_server.c_str(),
+		.stun_server_port = snp_config.stun_port,
+
+		// libjuice muxes every agent created with the same single port onto one socket
+		.local_port_range_begin = mux ? snp_config.mux_port : (u16)0,
+		.local_port_range_end = mux ? snp_config.mux_port : (u16)0,
+
+		.cb_state_changed = on_state,
+		.cb_candidate = on_candidate,
+		.cb_gathering_done = on_done,
+		.cb_recv = on_receive,
+		.user_ptr = this,
+	};
+	if (!m_turn_servers.empty()) {
+		juice_turn_server servers[5]{};
+		for (unsigned int i = 0; i < m_turn_servers.size() && i < 5; i++) {
+			turn_hosts[i] = cache.resolve(m_turn_servers[i].host, m_turn_servers[i].port);
+			servers[i].host = turn_hosts[i].c_str();
+			servers[i].username = m_turn_servers[i].username.c_str();
+			servers[i].password = m_turn_servers[i].password.c_str();
+			servers[i].port = m_turn_servers[i].port;
+		}
+		config.turn_servers = servers;
+		config.turn_servers_count = (m_turn_servers.size() < 5) ? m_turn_servers.size() : 5;
+
+	}
+	return juice_create(&config);
+}
+
 void JuiceAgent::mark_last_signal() {
 	mark_active();
-	m_last_signal = std::chrono::steady_clock::now();
+	// ICE only starts while the peer has signaled recently, each signal pushes the window's end back
+	auto& manager = g_crown_link->juice_manager();
+	manager.cancel_timer(m_signal_window_timer);
+	m_signal_window_open = true;
+	m_signal_window_timer = manager.schedule_agent_timer(*this, SIGNAL_WINDOW, [](JuiceAgent& agent, const auto&) {
+		agent.m_signal_window_open = false;
+	});
 	try_initialize();
 }
 
 void JuiceAgent::try_initialize() {
 	send_signal_ping();
-	if (m_p2p_state == JUICE_STATE_DISCONNECTED && std::chrono::steady_clock::now() - m_last_signal < 10s) {
+	if (m_p2p_state == JUICE_STATE_DISCONNECTED && m_signal_window_open) {
 		char sdp[JUICE_MAX_SDP_STRING_LEN]{};
 		juice_get_local_description(m_agent, sdp, sizeof(sdp));
 
-		g_crown_link->signaling_socket().send_packet(m_address, SignalMessageType::JuiceLocalDescription, sdp);
+		g_crown_link->signaling_socket().post_packet(m_address, SignalMessageType::JuiceLocalDescription, sdp);
 		spdlog::trace("Init - local SDP {}", sdp);
+		if (!std::exchange(m_reuse_checked, true)) {
+			m_reused_candidate = CandidateCache::instance().reusable_candidate();
+			if (!m_reused_candidate.empty()) {
+				spdlog::debug("Reusing server reflexive candidate for {}: {}", m_address.b64(), m_reused_candidate);
+				signal_candidate(m_reused_candidate.c_str());
+			}
+		}
+		m_gathering_started = std::chrono::steady_clock::now();
 		juice_gather_candidates(m_agent);
 	}
 }
 
+// At most one ping per interval, a request while one was just sent goes out when the interval ends
 void JuiceAgent::send_signal_ping() {
-	if (std::chrono::steady_clock::now() - m_last_ping > 1s) {
-		g_crown_link->signaling_socket().send_packet(m_address, SignalMessageType::SignalingPing, "");
-		m_last_ping = std::chrono::steady_clock::now();
+	m_ping_requested = true;
+	if (!m_ping_running) {
+		ping();
+	}
+}
+
+void JuiceAgent::ping() {
+	m_ping_running = std::exchange(m_ping_requested, false);
+	if (!m_ping_running) {
+		return;
 	}
+	g_crown_link->signaling_socket().post_packet(m_address, SignalMessageType::SignalingPing, "");
+	g_crown_link->juice_manager().schedule_agent_timer(*this, PING_INTERVAL, [](JuiceAgent& agent, const auto&) {
+		agent.ping();
+	});
 }
 
 void JuiceAgent::handle_signal_packet(const SignalPacket& packet) {
@@ -90,19 +247,96 @@ void JuiceAgent::handle_signal_packet(const SignalPacket& packet) {
             spdlog::trace("Remote gathering done");
             juice_set_remote_gathering_done(m_agent);
         } break;
+        case SignalMessageType::JuiceCandidateBatch: {
+            spdlog::trace("Received remote candidates:\n{}", packet.data);
+            for_each_candidate(packet.data,
+                [this](const std::string& candidate) { juice_add_remote_candidate(m_agent, candidate.c_str()); },
+                [this] { juice_set_remote_gathering_done(m_agent); });
+        } break;
+        case SignalMessageType::JuiceRelayDescription: {
+            if (auto relay = ensure_relay_path()) {
+                spdlog::trace("Received remote relay description:\n{}", packet.data);
+                juice_set_remote_description(relay, packet.data.c_str());
+            }
+        } break;
+        case SignalMessageType::JuiceRelayCandidate: {
+            if (auto relay = ensure_relay_path()) {
+                juice_add_remote_candidate(relay, packet.data.c_str());
+            }
+        } break;
+        case SignalMessageType::JuiceRelayDone: {
+            if (auto relay = ensure_relay_path()) {
+                juice_set_remote_gathering_done(relay);
+            }
+        } break;
+        case SignalMessageType::JuiceRelayCandidateBatch: {
+            if (auto relay = ensure_relay_path()) {
+                for_each_candidate(packet.data,
+                    [relay](const std::string& candidate) { juice_add_remote_candidate(relay, candidate.c_str()); },
+                    [relay] { juice_set_remote_gathering_done(relay); });
+            }
+        } break;
+	}
+}
+
+// Both sides start their relay session once they know the other supports it, whichever side
+// signals first makes the other one start as well
+juice_agent_t* JuiceAgent::ensure_relay_path() {
+	if (!m_multipath.enabled) {
+		return nullptr;
+	}
+
+	juice_agent_t* relay = nullptr;
+	{
+		std::unique_lock lock{m_path_mutex};
+		if (m_relay_agent) {
+			return m_relay_agent;
+		}
+		relay = m_relay_agent = create_juice_agent(on_relay_state_changed, on_relay_candidate, on_relay_gathering_done, on_relay_recv);
+	}
+	if (!relay) {
+		return nullptr;
+	}
+
+	if (m_turn_servers.empty()) {
+		spdlog::warn("No TURN server known, second path to {} will be another direct session", m_address.b64());
 	}
+	char sdp[JUICE_MAX_SDP_STRING_LEN]{};
+	juice_get_local_description(relay, sdp, sizeof(sdp));
+	g_crown_link->signaling_socket().post_packet(m_address, SignalMessageType::JuiceRelayDescription, sdp);
+	juice_gather_candidates(relay);
+	return relay;
 }
 
 void JuiceAgent::send_message(void* data, size_t size) {
 	mark_active();
+	if (m_first_send_ns == 0) {
+		m_state_at_first_send = m_p2p_state;
+		m_first_send_ns = steady_ns();
+	}
 
-	switch (m_p2p_state) {
+	// With multipath the relay session keeps the peer reachable while the direct one is down
+	const auto state = m_path_selector.is_usable(PathId::Relay) ? JUICE_STATE_CONNECTED : m_p2p_state;
+	switch (state) {
         case JUICE_STATE_DISCONNECTED:{
             try_initialize();
         } break;		
         case JUICE_STATE_CONNECTED:
         case JUICE_STATE_COMPLETED: {
-            juice_send(m_agent, (const char*)data, size);
+            const StormPacketView packet{(const char*)data, size};
+            const auto packet_class = packet.classify();
+            m_sent_packets.add(packet_class);
+            if (spdlog::should_log(spdlog::level::trace)) {
+                spdlog::trace("Send to {}: {}", m_address.b64(), packet.describe());
+            }
+            if (m_ack_elision && m_ack_elision->suppress((const char*)data, size, packet_class)) {
+                break;
+            }
+            if (m_send_scheduler) {
+                m_send_scheduler->send((const char*)data, size, packet_class);
+            } else {
+                send_packet((const char*)data, size);
+            }
         } break;
         case JUICE_STATE_FAILED: {
             spdlog::dump_backtrace();
@@ -115,14 +349,354 @@ void JuiceAgent::send_message(void* data, size_t size) {
 	}
 }
 
+void JuiceAgent::send_packet(const char* data, size_t size) {
+	char compressed[MAX_FRAME_SIZE];
+	if (const auto compressed_size = compress_packet(data, size, compressed)) {
+		data = compressed;
+		size = compressed_size;
+	}
+
+	if (m_fec_encoder && m_peer_speaks_frames) {
+		m_fec_encoder->encode(data, size, [this](const char* frame, size_t frame_size) {
+			transmit(frame, frame_size);
+		});
+		send_probes();
+		return;
+	}
+
+	transmit(data, size);
+	send_probes();
+	if (!m_peer_speaks_frames && m_hello_attempts < 5 && std::chrono::steady_clock::now() - m_last_hello > 1s) {
+		m_hello_attempts++;
+		m_last_hello = std::chrono::steady_clock::now();
+		send_hello(0);
+	}
+}
+
+size_t JuiceAgent::compress_packet(const char* data, size_t size, char* out) {
+	if (!m_compression.enabled || !has_feature(PEER_FEATURE_COMPRESSION)
+		|| size < m_compression.min_size || size <= sizeof(FrameHeader) + 1 || size > MAX_FRAME_PAYLOAD) {
+		return 0;
+	}
+
+	// Only worth it if the frame ends up smaller than the packet itself
+	const auto compressed_size = compression::compress(data, size, out + sizeof(FrameHeader), size - sizeof(FrameHeader) - 1);
+	if (!compressed_size) {
+		return 0;
+	}
+	m_uncompressed_bytes += size;
+	m_compressed_bytes += sizeof(FrameHeader) + compressed_size;
+	return write_frame(out, FrameType::Compressed, 0, (u16)size) + compressed_size;
+}
+
+void JuiceAgent::send_hello(u8 flags) {
+	const PeerCapabilities capabilities{
+		.version = PEER_PROTOCOL_VERSION,
+		.legacy_features = (u8)m_local_features,
+		.max_payload = MAX_PEER_PAYLOAD,
+		.mode = (u8)g_crown_link->mode(),
+		.features = m_local_features,
+	};
+	char frame[MAX_FRAME_SIZE];
+	transmit(frame, write_frame(frame, FrameType::Hello, flags, 0, (const char*)&capabilities, sizeof(capabilities)));
+}
+
+void JuiceAgent::handle_hello(const FrameHeader& header, const char* payload, size_t size) {
+	const auto capabilities = read_capabilities(payload, size);
+	m_peer_features = capabilities.features;
+	m_peer_max_payload = capabilities.max_payload;
+	if (!m_peer_speaks_frames.exchange(true)) {
+		spdlog::debug("Peer {} understands CrownLink frames, protocol {}, features 0x{:x} (both: 0x{:x}), max payload {}",
+			m_address.b64(), capabilities.version, capabilities.features, capabilities.features & m_local_features, capabilities.max_payload);
+		if (capabilities.version >= 2 && capabilities.mode != (u8)g_crown_link->mode()) {
+			spdlog::warn("Peer {} runs CrownLink mode {}, ours is {}", m_address.b64(), capabilities.mode, (u8)g_crown_link->mode());
+		}
+	}
+	if (!(header.flags & FRAME_FLAG_REPLY)) {
+		send_hello(FRAME_FLAG_REPLY);
+	}
+}
+
+// Signaling carries the bye as well, this one just gets there first
+void JuiceAgent::send_bye() {
+	if (m_peer_speaks_frames && is_reachable()) {
+		char frame[MAX_FRAME_SIZE];
+		transmit(frame, write_frame(frame, FrameType::Bye, 0, 0));
+	}
+}
+
+void JuiceAgent::send_loss_report(f64 loss) {
+	const auto permyriad = (u16)std::clamp(loss * 10000, 0.0, 10000.0);
+	char frame[MAX_FRAME_SIZE];
+	transmit(frame, write_frame(frame, FrameType::LossReport, 0, 0, (const char*)&permyriad, sizeof(permyriad)));
+}
+
+void JuiceAgent::send_probes() {
+	// Forwarding picks relays by RTT, so it needs the probes on the direct path as well
+	const bool multipath = has_feature(PEER_FEATURE_MULTIPATH);
+	const bool forwarding = has_feature(PEER_FEATURE_FORWARDING);
+	if (!(multipath || forwarding) || !m_path_selector.probe_due()) {
+		return;
+	}
+	send_probe(PathId::Direct, 0, ProbePayload{.path = (u8)PathId::Direct, .sent_ns = steady_ns()});
+	if (multipath) {
+		ensure_relay_path();
+		send_probe(PathId::Relay, 0, ProbePayload{.path = (u8)PathId::Relay, .sent_ns = steady_ns()});
+	}
+}
+
+bool JuiceAgent::is_reachable() const {
+	return is_connected(m_p2p_state) || is_connected(m_relay_state);
+}
+
+std::vector<RouteEntry> JuiceAgent::peer_routes() {
+	std::lock_guard lock{m_routes_mutex};
+	return m_peer_routes;
+}
+
+void JuiceAgent::send_routes(const std::vector<RouteEntry>& routes) {
+	char payload[MAX_FRAME_PAYLOAD];
+	char frame[MAX_FRAME_SIZE];
+	transmit(frame, write_frame(frame, FrameType::Routes, 0, 0, payload, write_routes(payload, routes)));
+}
+
+void JuiceAgent::send_forwarded(const NetAddress& origin, const NetAddress& destination, u16 sequence, const char* data, size_t size) {
+	char payload[sizeof(ForwardHeader) + MAX_FRAME_PAYLOAD];
+	const ForwardHeader forward{.origin = origin, .destination = destination};
+	size = std::min(size, MAX_FRAME_PAYLOAD);
+	if (sizeof(forward) + size > m_peer_max_payload) {
+		spdlog::trace("Not forwarding {} bytes through {}, it takes at most {}", size, m_address.b64(), m_peer_max_payload.load());
+		return;
+	}
+	memcpy(payload, &forward, sizeof(forward));
+	memcpy(payload + sizeof(forward), data, size);
+
+	char frame[MAX_FRAME_SIZE];
+	transmit(frame, write_frame(frame, FrameType::Forward, 0, sequence, payload, sizeof(forward) + size));
+}
+
+void JuiceAgent::set_forward_relay(const NetAddress& relay) {
+	mark_active();
+	m_is_forwarded = true;
+	if (relay != m_forward_relay) {
+		spdlog::info("Peer {} is not reachable directly, forwarding through {}", m_address.b64(), relay.b64());
+		m_forward_relay = relay;
+	}
+}
+
+void JuiceAgent::send_probe(PathId path, u8 flags, const ProbePayload& probe) {
+	char frame[MAX_FRAME_SIZE];
+	const auto frame_size = write_frame(frame, FrameType::Probe, flags, 0, (const char*)&probe, sizeof(probe));
+	std::shared_lock lock{m_path_mutex};
+	transmit_on(path, frame, frame_size);
+}
+
+void JuiceAgent::transmit(const char* data, size_t size) {
+	if (!m_multipath.enabled) {
+		transmit_on(PathId::Direct, data, size);
+		return;
+	}
+
+	std::shared_lock lock{m_path_mutex};
+	const auto active = m_path_selector.active();
+	transmit_on(active, data, size);
+	if (m_multipath.mode == MultipathMode::Both) {
+		const auto other = active == PathId::Direct ? PathId::Relay : PathId::Direct;
+		if (m_path_selector.is_usable(other)) {
+			transmit_on(other, data, size);
+		}
+	}
+}
+
+void JuiceAgent::transmit_on(PathId path, const char* data, size_t size) {
+	// Sending on the other session from inside a callback would take its connection lock while
+	// holding ours, and that session's callback may be doing the reverse
+	const auto target = path == PathId::Relay ? m_relay_agent : m_agent;
+	if (t_callback_agent && target && t_callback_agent != target) {
+		post_transmit(path, data, size);
+		return;
+	}
+	if (path == PathId::Relay) {
+		if (m_relay_agent && is_connected(m_relay_state)) {
+			juice_send(m_relay_agent, data, size);
+		}
+	} else if (m_outbound_impairment) {
+		m_outbound_impairment->process(data, size);
+	} else {
+		juice_send(m_agent, data, size);
+	}
+}
+
+void JuiceAgent::post_transmit(PathId path, const char* data, size_t size) {
+	if (!g_crown_link) {
+		return;
+	}
+	g_crown_link->juice_manager().post_agent_task(*this, [path, packet = std::string{data, size}](JuiceAgent& agent, const auto&) {
+		std::shared_lock lock{agent.m_path_mutex};
+		agent.transmit_on(path, packet.data(), packet.size());
+	});
+}
+
+void JuiceAgent::receive(const char* data, size_t size) {
+	if (m_inbound_impairment) {
+		m_inbound_impairment->process(data, size);
+	} else {
+		handle_datagram(data, size);
+	}
+}
+
+void JuiceAgent::handle_datagram(const char* data, size_t size) {
+	if (!is_frame(data, size)) {
+		enqueue_received(data, size);
+		return;
+	}
+
+	FrameHeader header;
+	memcpy(&header, data, sizeof(header));
+	const auto payload = data + sizeof(header);
+	const auto payload_size = size - sizeof(header);
+	const auto deliver = [this](const char* packet, size_t packet_size) {
+		deliver_packet(packet, packet_size);
+	};
+
+	switch (header.type) {
+		case FrameType::Hello: {
+			handle_hello(header, payload, payload_size);
+		} break;
+		case FrameType::Data: {
+			m_fec_decoder.on_data(header, payload, payload_size, deliver);
+			if (const auto loss = m_fec_decoder.take_loss_report()) {
+				send_loss_report(*loss);
+			}
+		} break;
+		case FrameType::Parity: {
+			m_fec_decoder.on_parity(header, payload, payload_size, deliver);
+		} break;
+		case FrameType::LossReport: {
+			u16 permyriad = 0;
+			if (payload_size < sizeof(permyriad)) {
+				break;
+			}
+			memcpy(&permyriad, payload, sizeof(permyriad));
+			if (m_fec_encoder) {
+				m_fec_encoder->handle_loss_report(permyriad / 10000.0);
+			}
+			if (m_send_scheduler) {
+				m_send_scheduler->handle_loss_report(permyriad / 10000.0);
+			}
+		} break;
+		case FrameType::Compressed: {
+			deliver_packet(data, size);
+		} break;
+		case FrameType::Forward: {
+			handle_forward(data, size, header);
+		} break;
+		case FrameType::Routes: {
+			auto routes = read_routes(payload, payload_size);
+			std::lock_guard lock{m_routes_mutex};
+			m_peer_routes = std::move(routes);
+		} break;
+		case FrameType::Bye: {
+			// Tearing down this agent joins the thread we are on, the signaling thread does it
+			g_crown_link->timers().schedule(0ms, [address = m_address] {
+				g_crown_link->handle_bye(address);
+			});
+		} break;
+		case FrameType::Probe: {
+			ProbePayload probe;
+			if (payload_size < sizeof(probe)) {
+				break;
+			}
+			memcpy(&probe, payload, sizeof(probe));
+			const auto path = probe.path == (u8)PathId::Relay ? PathId::Relay : PathId::Direct;
+			if (header.flags & FRAME_FLAG_REPLY) {
+				m_path_selector.on_rtt_sample(path, std::chrono::nanoseconds{steady_ns() - probe.sent_ns});
+			} else {
+				send_probe(path, FRAME_FLAG_REPLY, probe);
+			}
+		} break;
+	}
+}
+
+// A Storm packet, possibly compressed, either straight off the wire or unwrapped from a Data frame
+void JuiceAgent::deliver_packet(const char* data, size_t size) {
+	if (!is_frame(data, size)) {
+		enqueue_received(data, size);
+		return;
+	}
+	FrameHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.type != FrameType::Compressed) {
+		return;
+	}
+
+	char packet[MAX_FRAME_PAYLOAD];
+	const auto packet_size = compression::decompress(data + sizeof(header), size - sizeof(header), packet, sizeof(packet));
+	if (packet_size == 0 || packet_size != header.sequence) {
+		spdlog::warn("Dropping malformed compressed packet from {}", m_address.b64());
+		return;
+	}
+	enqueue_received(packet, packet_size);
+}
+
+void JuiceAgent::handle_forward(const char* frame, size_t size, const FrameHeader& header) {
+	ForwardHeader forward;
+	if (!m_forwarding.enabled || size < sizeof(FrameHeader) + sizeof(forward)) {
+		return;
+	}
+	memcpy(&forward, frame + sizeof(FrameHeader), sizeof(forward));
+	const auto packet = frame + sizeof(FrameHeader) + sizeof(forward);
+	const auto packet_size = size - sizeof(FrameHeader) - sizeof(forward);
+
+	if (forward.destination == g_crown_link->client_id()) {
+		if (m_forward_deduplicator.is_new(forward.origin, header.sequence)) {
+			enqueue_received(packet, packet_size, &forward.origin);
+		}
+		return;
+	}
+
+	// Relaying needs the agent of the destination, which lives behind the manager's lock. That lock is
+	// held while agents are destroyed, which joins this receive thread, so hop over to the task thread.
+	TaskScheduler::instance().schedule(TaskScheduler::Clock::now(), [destination = forward.destination, frame = std::string{frame, size}] {
+		if (g_crown_link) {
+			g_crown_link->juice_manager().relay_frame(destination, frame.data(), frame.size());
+		}
+	});
+}
+
+void JuiceAgent::enqueue_received(const char* data, size_t size, const NetAddress* sender) {
+	const StormPacketView packet{data, size};
+	m_received_packets.add(packet.classify());
+	if (spdlog::should_log(spdlog::level::trace)) {
+		spdlog::trace("Received from {}: {}", m_address.b64(), packet.describe());
+	}
+	if (const auto first_send = m_first_send_ns.load(); first_send && !m_first_receive_logged.exchange(true)) {
+		spdlog::info("First packet from {} {:.1f} ms after the first send, ICE was {} by then", m_address.b64(),
+			(steady_ns() - first_send) / 1e6, as_string(m_state_at_first_send));
+	}
+	// Packets released later by the inbound impairment count as received then
+	const auto received_ns = t_received_ns ? t_received_ns : steady_ns();
+	if (m_reorder_buffer && !sender) {
+		m_reorder_buffer->process(data, size, received_ns);
+		return;
+	}
+	g_crown_link->receive_queue().push(GamePacket{sender ? *sender : m_address, data, size, received_ns});
+}
+
 void JuiceAgent::on_state_changed(juice_agent_t* agent, juice_state_t state, void* user_ptr) {
 	JuiceAgent& parent = *(JuiceAgent*)user_ptr;
+	const CallbackScope scope{agent};
 	parent.mark_active();
+	if (state == JUICE_STATE_FAILED) {
+		parent.m_failed_ns = steady_ns();
+	}
 	parent.m_p2p_state = state;
+	parent.m_path_selector.set_usable(PathId::Direct, is_connected(state));
 	spdlog::debug("Connection changed state, new state: {}", to_string(state));
 	switch (state) {
         case JUICE_STATE_CONNECTED: {
             spdlog::info("Initially connected");
+            parent.send_hello(0);
         } break;
         case JUICE_STATE_COMPLETED: {
             spdlog::info("Connection negotiation finished");
@@ -138,7 +712,7 @@ void JuiceAgent::on_state_changed(juice_agent_t* agent, juice_state_t state, voi
                 parent.set_connection_type(JuiceConnectionType::Relay);
                 spdlog::warn("Remote connection is relayed, performance may be affected");
             }
-            if (std::regex_match(local, std::regex(".+26.\\d+.\\d+.\\d+.+"))) {
+            if (std::regex_match(local, RADMIN_CANDIDATE)) {
                 parent.set_connection_type(JuiceConnectionType::Radmin);
                 spdlog::warn("CrownLink is connected over Radmin - performance will be worse than peer-to-peer");
             }
@@ -147,30 +721,93 @@ void JuiceAgent::on_state_changed(juice_agent_t* agent, juice_state_t state, voi
         case JUICE_STATE_FAILED: {
             spdlog::dump_backtrace();
             spdlog::error("Could not connect, gave up");
+            // The pass runs on the signaling thread, it picks a relay for us if forwarding is enabled
+            g_crown_link->juice_manager().request_expiry_check();
         } break;
 	}
 }
 
+void JuiceAgent::signal_candidate(const char* sdp) {
+	if (std::regex_match(sdp, RADMIN_CANDIDATE)) {
+		spdlog::info("skipped sending radmin candidate: {}", sdp);
+	} else if (m_candidate_batcher) {
+		m_candidate_batcher->add(sdp);
+	} else {
+		g_crown_link->signaling_socket().post_packet(m_address, SignalMessageType::JuciceCandidate, sdp);
+	}
+}
+
 void JuiceAgent::on_candidate(juice_agent_t* agent, const char* sdp, void* user_ptr) {
 	auto& parent = *(JuiceAgent*)user_ptr;
 	parent.mark_active();
-	if (!std::regex_match(sdp, std::regex(".+26.\\d+.\\d+.\\d+.+"))) {
-		g_crown_link->signaling_socket().send_packet(parent.m_address, SignalMessageType::JuciceCandidate, sdp);
-	} else {
-		spdlog::info("skipped sending radmin candidate: {}", sdp);
+	CandidateCache::instance().on_local_candidate(sdp);
+	// The peer already has it from the cache
+	if (!parent.m_reused_candidate.empty() && CandidateCache::same_endpoint(sdp, parent.m_reused_candidate)) {
+		return;
 	}
+	parent.signal_candidate(sdp);
 }
 
 void JuiceAgent::on_gathering_done(juice_agent_t* agent, void* user_ptr) {
 	auto& parent = *(JuiceAgent*)user_ptr;
 	parent.mark_active();
-	g_crown_link->signaling_socket().send_packet(parent.m_address, SignalMessageType::JuiceDone);
+	CandidateCache::instance().on_gathering_done(parent.m_address, std::chrono::steady_clock::now() - parent.m_gathering_started);
+	if (parent.m_candidate_batcher) {
+		parent.m_candidate_batcher->finish();
+	} else {
+		g_crown_link->signaling_socket().post_packet(parent.m_address, SignalMessageType::JuiceDone);
+	}
 }
 
 void JuiceAgent::on_recv(juice_agent_t* agent, const char* data, size_t size, void* user_ptr) {
 	auto& parent = *(JuiceAgent*)user_ptr;
+	const CallbackScope scope{agent};
+	t_received_ns = steady_ns();
+	parent.mark_active();
+	parent.receive(data, size);
+	t_received_ns = 0;
+}
+
+void JuiceAgent::on_relay_state_changed(juice_agent_t* agent, juice_state_t state, void* user_ptr) {
+	auto& parent = *(JuiceAgent*)user_ptr;
+	const CallbackScope scope{agent};
+	parent.mark_active();
+	parent.m_relay_state = state;
+	parent.m_path_selector.set_usable(PathId::Relay, is_connected(state));
+	spdlog::debug("Relay path to {} changed state, new state: {}", parent.m_address.b64(), to_string(state));
+	if (state == JUICE_STATE_FAILED) {
+		g_crown_link->juice_manager().request_expiry_check();
+	}
+}
+
+void JuiceAgent::on_relay_candidate(juice_agent_t* agent, const char* sdp, void* user_ptr) {
+	auto& parent = *(JuiceAgent*)user_ptr;
+	// Only relay candidates, otherwise ICE would just find the direct route a second time
+	if (!parent.m_turn_servers.empty() && std::string{sdp}.find("typ relay") == std::string::npos) {
+		return;
+	}
+	if (parent.m_relay_candidate_batcher) {
+		parent.m_relay_candidate_batcher->add(sdp);
+	} else {
+		g_crown_link->signaling_socket().post_packet(parent.m_address, SignalMessageType::JuiceRelayCandidate, sdp);
+	}
+}
+
+void JuiceAgent::on_relay_gathering_done(juice_agent_t* agent, void* user_ptr) {
+	auto& parent = *(JuiceAgent*)user_ptr;
+	if (parent.m_relay_candidate_batcher) {
+		parent.m_relay_candidate_batcher->finish();
+	} else {
+		g_crown_link->signaling_socket().post_packet(parent.m_address, SignalMessageType::JuiceRelayDone);
+	}
+}
+
+void JuiceAgent::on_relay_recv(juice_agent_t* agent, const char* data, size_t size, void* user_ptr) {
+	auto& parent = *(JuiceAgent*)user_ptr;
+	const CallbackScope scope{agent};
+	t_received_ns = steady_ns();
 	parent.mark_active();
-	//g_crown_link->receive_queue().emplace(GamePacket{parent.m_address, data, size});
-	g_crown_link->receive_queue().enqueue(GamePacket{ parent.m_address, data, size });
-	SetEvent(g_receive_event);
+	// Same as the direct path, the inbound impairment covers both
+	parent.receive(data, size);
+	t_received_ns = 0;
 }
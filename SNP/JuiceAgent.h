@@ -1,5 +1,17 @@
 #pragma once
 #include "Common.h"
+#include "Impairment.h"
+#include "Fec.h"
+#include "Compression.h"
+#include "SendScheduler.h"
+#include "AckElision.h"
+#include "Multipath.h"
+#include "Forwarding.h"
+#include "CandidateCache.h"
+#include "CandidateBatch.h"
+#include "Reorder.h"
+#include "TimerWheel.h"
+#include <shared_mutex>
 
 struct SignalPacket;
 
@@ -27,32 +39,155 @@ public:
 	void handle_signal_packet(const SignalPacket& packet);
 	void send_message(void* data, const size_t size);
 	void send_signal_ping();
+	void send_bye();
 
 public:
 	const NetAddress& address() const { return m_address; }
+	// Unique per agent, a new agent for the same address gets a new id
+	u64 id() const { return m_id; }
 	juice_state state() const { return m_p2p_state; }
-	bool is_active() const { return state() != JUICE_STATE_FAILED && std::chrono::steady_clock::now() - m_last_active < 5min; }
+	// steady_ns() when ICE gave up, 0 before
+	s64 failed_ns() const { return m_failed_ns; }
+	static constexpr auto IDLE_TIMEOUT = 5min;
+	static constexpr auto SIGNAL_WINDOW = 10s;
+	static constexpr auto PING_INTERVAL = 1s;
+
+	bool is_active() const {
+		// A failed agent that is being forwarded for stays around, it holds the forwarding state
+		const bool reachable = state() != JUICE_STATE_FAILED || m_relay_state == JUICE_STATE_CONNECTED || m_relay_state == JUICE_STATE_COMPLETED
+			|| m_is_forwarded;
+		return reachable && std::chrono::steady_clock::now() < expires_at();
+	}
+	std::chrono::steady_clock::time_point expires_at() const { return m_last_active + IDLE_TIMEOUT; }
 	void set_connection_type(JuiceConnectionType ct) { m_connection_type = ct; };
 	JuiceConnectionType connection_type() const { return m_connection_type; };
 	void mark_last_signal();
+	// Storm sent or received something, the session is no longer only prewarmed
+	bool has_game_traffic() const { return m_first_send_ns != 0 || m_received_packets.total(); }
+
+	// Forwarding, see JuiceManager::send_p2p
+	bool is_reachable() const;
+	bool can_relay() const { return has_feature(PEER_FEATURE_FORWARDING) && is_reachable(); }
+	f64 rtt_ms() { return m_path_selector.rtt_ms(m_path_selector.active()); }
+	std::vector<RouteEntry> peer_routes();
+	void send_routes(const std::vector<RouteEntry>& routes);
+	void send_forwarded(const NetAddress& origin, const NetAddress& destination, u16 sequence, const char* data, size_t size);
+	void relay_frame(const char* frame, size_t size) { transmit(frame, size); }
+	void set_forward_relay(const NetAddress& relay);
+	// Only under the manager lock, on the agent of the destination
+	u16 next_forward_sequence() { return m_forward_sequence++; }
+	// Only under the manager lock, Storm sent the peer its leave and a bye is scheduled
+	bool leaving() const { return m_leaving; }
+	void set_leaving() { m_leaving = true; }
 
 private:
 	void mark_active() { m_last_active = std::chrono::steady_clock::now(); }
+	// Negotiated in the Hello, only what both sides announced
+	bool has_feature(u32 feature) const { return m_local_features & m_peer_features & feature; }
+	void handle_hello(const FrameHeader& header, const char* payload, size_t size);
 	void try_initialize();
+	void signal_candidate(const char* sdp);
+	void ping();
+	juice_agent_t* create_juice_agent(juice_cb_state_changed_t on_state, juice_cb_candidate_t on_candidate,
+		juice_cb_gathering_done_t on_done, juice_cb_recv_t on_receive);
+	juice_agent_t* ensure_relay_path();
+	void send_packet(const char* data, size_t size);
+	size_t compress_packet(const char* data, size_t size, char* out);
+	void send_hello(u8 flags);
+	void send_loss_report(f64 loss);
+	void send_probes();
+	void send_probe(PathId path, u8 flags, const ProbePayload& probe);
+	void transmit(const char* data, size_t size);
+	void transmit_on(PathId path, const char* data, size_t size);
+	void post_transmit(PathId path, const char* data, size_t size);
+	void receive(const char* data, size_t size);
+	void handle_datagram(const char* data, size_t size);
+	void deliver_packet(const char* data, size_t size);
+	void handle_forward(const char* frame, size_t size, const FrameHeader& header);
+	void enqueue_received(const char* data, size_t size, const NetAddress* sender = nullptr);
 
 	static void on_state_changed(juice_agent_t* agent, juice_state_t state, void* user_ptr);
 	static void on_candidate(juice_agent_t* agent, const char* sdp, void* user_ptr);
 	static void on_gathering_done(juice_agent_t* agent, void* user_ptr);
 	static void on_recv(juice_agent_t* agent, const char* data, size_t size, void* user_ptr);
+	static void on_relay_state_changed(juice_agent_t* agent, juice_state_t state, void* user_ptr);
+	static void on_relay_candidate(juice_agent_t* agent, const char* sdp, void* user_ptr);
+	static void on_relay_gathering_done(juice_agent_t* agent, void* user_ptr);
+	static void on_relay_recv(juice_agent_t* agent, const char* data, size_t size, void* user_ptr);
 
 private:
 	bool m_is_relayed = false;
 	bool m_is_radmin = false;
 	JuiceConnectionType m_connection_type = JuiceConnectionType::Standard;
+	inline static std::atomic<u64> s_next_id = 1;
+	const u64 m_id = s_next_id++;
 	std::chrono::steady_clock::time_point m_last_active;
-	std::chrono::steady_clock::time_point m_last_signal;
-	std::chrono::steady_clock::time_point m_last_ping = std::chrono::steady_clock::now() - 1s;
+	std::chrono::steady_clock::time_point m_gathering_started;
+	// Signaled before gathering started, set once before the first gathering and only read after
+	std::string m_reused_candidate;
+	bool m_reuse_checked = false;
+	// Both driven by timers on the signaling thread, only touched under the manager lock
+	bool m_signal_window_open = false;
+	TimerWheel::TimerId m_signal_window_timer = 0;
+	bool m_ping_running = false;
+	bool m_ping_requested = false;
 	juice_state m_p2p_state = JUICE_STATE_DISCONNECTED;
 	NetAddress m_address;
 	juice_agent_t* m_agent;
+	std::vector<TurnServer> m_turn_servers;
+
+	// Multipath: a second ICE session next to m_agent, both kept warm with RTT probes.
+	// m_path_mutex keeps m_relay_agent alive while another thread sends on it
+	const MultipathConfig m_multipath;
+	PathSelector m_path_selector;
+	juice_agent_t* m_relay_agent = nullptr;
+	std::atomic<juice_state> m_relay_state = JUICE_STATE_DISCONNECTED;
+	std::shared_mutex m_path_mutex;
+
+	const ForwardingConfig m_forwarding;
+	std::vector<RouteEntry> m_peer_routes;
+	std::mutex m_routes_mutex;
+	// Frames forwarded to this peer, the destination dedups per origin so one relay carrying frames
+	// for several destinations cannot share a counter
+	u16 m_forward_sequence = 0;
+	bool m_leaving = false;
+	NetAddress m_forward_relay{};
+	std::atomic<bool> m_is_forwarded = false;
+	std::atomic<s64> m_failed_ns = 0;
+	ForwardDeduplicator m_forward_deduplicator;
+
+	// Frames are only sent once the peer said hello, older clients keep getting raw Storm packets
+	std::atomic<bool> m_peer_speaks_frames = false;
+	u32 m_local_features = 0;
+	std::atomic<u32> m_peer_features = 0;
+	std::atomic<u16> m_peer_max_payload = MAX_PEER_PAYLOAD;
+	u32 m_hello_attempts = 0;
+	std::chrono::steady_clock::time_point m_last_hello;
+	// Also numbers packets for the peer's loss reports when only the send scheduler is enabled
+	std::unique_ptr<FecEncoder> m_fec_encoder;
+	FecDecoder m_fec_decoder;
+	CompressionConfig m_compression;
+	std::atomic<u64> m_uncompressed_bytes = 0;
+	std::atomic<u64> m_compressed_bytes = 0;
+	StormPacketCounters m_sent_packets;
+	StormPacketCounters m_received_packets;
+
+	// Join latency: from the first packet Storm sends to this peer until the first one back
+	std::atomic<s64> m_first_send_ns = 0;
+	std::atomic<juice_state> m_state_at_first_send = JUICE_STATE_DISCONNECTED;
+	std::atomic<bool> m_first_receive_logged = false;
+
+	// Only set when candidate batching is enabled, otherwise every candidate is its own signaling message
+	std::shared_ptr<CandidateBatcher> m_candidate_batcher;
+	std::shared_ptr<CandidateBatcher> m_relay_candidate_batcher;
+
+	// Only set when reordering is enabled, forwarded packets from other peers bypass it
+	std::shared_ptr<ReorderBuffer> m_reorder_buffer;
+
+	std::shared_ptr<SendScheduler> m_send_scheduler;
+	std::optional<AckElision> m_ack_elision;
+
+	// Only set when impairment is enabled in the config, normal traffic never touches them
+	std::shared_ptr<NetworkImpairment> m_outbound_impairment;
+	std::shared_ptr<NetworkImpairment> m_inbound_impairment;
 };
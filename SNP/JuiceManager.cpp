@@ -1,6 +1,8 @@
 #include "JuiceManager.h"
 #include "Signaling.h"
 #include "JuiceAgent.h"
+#include "CrownLink.h"
+#include "TaskScheduler.h"
 
 JuiceAgent* JuiceManager::maybe_get_agent(const NetAddress& address, const std::lock_guard<std::mutex>&) {
 	auto it = m_agents.find(address);
@@ -10,31 +12,199 @@ JuiceAgent* JuiceManager::maybe_get_agent(const NetAddress& address, const std::
 	return nullptr;
 }
 
-JuiceAgent& JuiceManager::ensure_agent(const NetAddress& address, const std::lock_guard<std::mutex>&) {
+JuiceAgent& JuiceManager::ensure_agent(const NetAddress& address, const std::lock_guard<std::mutex>& lock) {
 	auto it = m_agents.find(address);
 	if (it != m_agents.end()) {
 		if (!it->second->is_active()) {
-			it->second = std::make_unique<JuiceAgent>(address, m_turn_servers);
+			retire(std::exchange(it->second, std::make_unique<JuiceAgent>(address, m_turn_servers)));
+			schedule_expiry(*it->second, lock);
+			m_agents_created++;
 		}
 		return *it->second;
 	}
 
 	const auto [new_it, _] = m_agents.emplace(address, std::make_unique<JuiceAgent>(address, m_turn_servers));
+	schedule_expiry(*new_it->second, lock);
+	m_agents_created++;
 	return *new_it->second;
 }
 
+TimerWheel::TimerId JuiceManager::schedule_agent_timer(const JuiceAgent& agent, std::chrono::steady_clock::duration delay,
+	std::function<void(JuiceAgent&, const std::lock_guard<std::mutex>&)> callback) {
+	return m_timers.schedule(delay, [this, address = agent.address(), id = agent.id(), callback = std::move(callback)] {
+		std::lock_guard lock{m_mutex};
+		// The address may have a newer agent by now, the timer belonged to the old one
+		if (auto agent = maybe_get_agent(address, lock); agent && agent->id() == id) {
+			callback(*agent, lock);
+		}
+	});
+}
+
+void JuiceManager::post_agent_task(const JuiceAgent& agent, std::function<void(JuiceAgent&, const std::lock_guard<std::mutex>&)> callback) {
+	TaskScheduler::instance().schedule(TaskScheduler::Clock::now(), [this, address = agent.address(), id = agent.id(), callback = std::move(callback)] {
+		std::lock_guard lock{m_mutex};
+		if (auto agent = maybe_get_agent(address, lock); agent && agent->id() == id) {
+			callback(*agent, lock);
+		}
+	});
+}
+
+// Traffic keeps pushing the idle timeout back, so the timer only decides when to look again
+void JuiceManager::schedule_expiry(const JuiceAgent& agent, const std::lock_guard<std::mutex>&) {
+	schedule_agent_timer(agent, agent.expires_at() - std::chrono::steady_clock::now(), [this](JuiceAgent& agent, const auto& lock) {
+		expire(agent, lock);
+	});
+}
+
+void JuiceManager::expire(JuiceAgent& agent, const std::lock_guard<std::mutex>& lock) {
+	if (agent.is_active() || start_forwarding(agent, lock)) {
+		schedule_expiry(agent, lock);
+		return;
+	}
+	auto it = m_agents.find(agent.address());
+	retire(std::move(it->second));
+	m_agents.erase(it);
+}
+
+void JuiceManager::retire(std::unique_ptr<JuiceAgent> agent) {
+	spdlog::debug("Retiring agent {}, state: {}", agent->address().b64(), as_string(agent->state()));
+	m_reaper.retire(std::move(agent));
+}
+
+// A burst of failures only queues one pass over all agents
+void JuiceManager::request_expiry_check() {
+	if (!m_check_all_agents.exchange(true)) {
+		m_timers.schedule(0ms, [this] { clear_inactive_agents(); });
+	}
+}
+
 void JuiceManager::clear_inactive_agents() {
 	std::lock_guard lock{m_mutex};
-	std::erase_if(m_agents, [](const auto& pair) {
-		const auto& [_, agent] = pair;
-		return !agent->is_active(); 
-	});
+	m_check_all_agents = false;
+	for (auto it = m_agents.begin(); it != m_agents.end();) {
+		// A failed agent is kept for forwarding, see send_p2p
+		auto& agent = *it->second;
+		if (!agent.is_active() && !start_forwarding(agent, lock) && !awaiting_routes(agent, lock)) {
+			retire(std::move(it->second));
+			it = m_agents.erase(it);
+		} else {
+			++it;
+		}
+	}
 }
 
 void JuiceManager::send_p2p(const NetAddress& address, void* data, size_t size) {
 	std::lock_guard lock{m_mutex};
+	report_routes(lock);
+	// Checked before ensure_agent, which would replace the failed agent with a new attempt
+	if (auto failed = maybe_get_agent(address, lock)) {
+		if (auto relay = start_forwarding(*failed, lock)) {
+			relay->send_forwarded(g_crown_link->client_id(), address, failed->next_forward_sequence(), (const char*)data, size);
+			schedule_leave_bye(*failed, data, size, lock);
+			return;
+		}
+		if (awaiting_routes(*failed, lock)) {
+			// Storm sends it again, by then a peer may have reported a route
+			return;
+		}
+	}
 	auto& agent = ensure_agent(address, lock);
 	agent.send_message(data, size);
+	schedule_leave_bye(agent, data, size, lock);
+}
+
+// After we left, the peer gets a bye like on shutdown and both sides drop the session
+void JuiceManager::schedule_leave_bye(JuiceAgent& agent, const void* data, size_t size, const std::lock_guard<std::mutex>& lock) {
+	if (agent.leaving() || !StormPacketView{(const char*)data, size}.is_player_leave()) {
+		return;
+	}
+	agent.set_leaving();
+	schedule_agent_timer(agent, LEAVE_BYE_DELAY, [this](JuiceAgent& agent, const auto&) {
+		spdlog::info("Left the game, saying bye to {}", agent.address().b64());
+		agent.send_bye();
+		g_crown_link->signaling_socket().post_packet(agent.address(), SignalMessageType::PeerBye);
+		auto it = m_agents.find(agent.address());
+		retire(std::move(it->second));
+		m_agents.erase(it);
+	});
+}
+
+void JuiceManager::relay_frame(const NetAddress& destination, const char* frame, size_t size) {
+	std::lock_guard lock{m_mutex};
+	// Only one hop, a relay never forwards through yet another relay
+	if (auto agent = maybe_get_agent(destination, lock); agent && agent->can_relay()) {
+		agent->relay_frame(frame, size);
+	}
+}
+
+// Picks the relay for a peer we could not connect to, the agent stays while it is forwarded for
+JuiceAgent* JuiceManager::start_forwarding(JuiceAgent& agent, const std::lock_guard<std::mutex>& lock) {
+	if (agent.state() != JUICE_STATE_FAILED || agent.is_reachable() || std::chrono::steady_clock::now() >= agent.expires_at()) {
+		return nullptr;
+	}
+	auto relay = find_relay(agent.address(), lock);
+	if (relay) {
+		agent.set_forward_relay(relay->address());
+	}
+	return relay;
+}
+
+// Routes are reported once a second, so right after a failure nobody may have offered one yet. As
+// long as some peer could relay, the failed agent waits a few reports before ICE starts over.
+bool JuiceManager::awaiting_routes(const JuiceAgent& agent, const std::lock_guard<std::mutex>&) {
+	const auto& config = SnpConfig::instance().forwarding;
+	const auto wait_ns = (s64)ROUTE_WAIT_REPORTS * config.report_interval_ms * 1'000'000;
+	if (!config.enabled || agent.state() != JUICE_STATE_FAILED || platform::steady_ns() - agent.failed_ns() > wait_ns) {
+		return false;
+	}
+	return std::any_of(m_agents.begin(), m_agents.end(), [&agent](const auto& entry) {
+		return entry.second.get() != &agent && entry.second->can_relay();
+	});
+}
+
+// Picks the peer with the lowest RTT to us plus its reported RTT to the destination
+JuiceAgent* JuiceManager::find_relay(const NetAddress& destination, const std::lock_guard<std::mutex>&) {
+	if (!SnpConfig::instance().forwarding.enabled) {
+		return nullptr;
+	}
+
+	JuiceAgent* best = nullptr;
+	f64 best_rtt = 0;
+	for (auto& [address, agent] : m_agents) {
+		if (address == destination || !agent->can_relay() || agent->rtt_ms() < 0) {
+			continue;
+		}
+		for (const auto& route : agent->peer_routes()) {
+			const auto rtt = agent->rtt_ms() + route.rtt_ms;
+			if (route.peer == destination && (!best || rtt < best_rtt)) {
+				best = agent.get();
+				best_rtt = rtt;
+			}
+		}
+	}
+	return best;
+}
+
+// Tells every forwarding capable peer which peers we reach and how fast, so it can pick us as relay
+void JuiceManager::report_routes(const std::lock_guard<std::mutex>&) {
+	const auto& config = SnpConfig::instance().forwarding;
+	const auto now = std::chrono::steady_clock::now();
+	if (!config.enabled || now - m_last_route_report < std::chrono::milliseconds{config.report_interval_ms}) {
+		return;
+	}
+	m_last_route_report = now;
+
+	std::vector<RouteEntry> routes;
+	for (auto& [address, agent] : m_agents) {
+		if (const auto rtt = agent->rtt_ms(); agent->is_reachable() && rtt >= 0) {
+			routes.push_back(RouteEntry{address, (u16)std::min(rtt, 65535.0)});
+		}
+	}
+	for (auto& [address, agent] : m_agents) {
+		if (agent->can_relay()) {
+			agent->send_routes(routes);
+		}
+	}
 }
 
 void JuiceManager::send_signal_ping(const NetAddress& address) {
@@ -49,6 +219,42 @@ void JuiceManager::mark_last_signal(const NetAddress& address) {
 	agent.mark_last_signal();
 }
 
+std::vector<NetAddress> JuiceManager::send_bye() {
+	std::lock_guard lock{m_mutex};
+	std::vector<NetAddress> peers;
+	for (auto& [address, agent] : m_agents) {
+		agent->send_bye();
+		peers.push_back(address);
+	}
+	return peers;
+}
+
+void JuiceManager::disconnect(const NetAddress& address) {
+	std::lock_guard lock{m_mutex};
+	if (auto it = m_agents.find(address); it != m_agents.end()) {
+		spdlog::info("Peer {} said bye", address.b64());
+		retire(std::move(it->second));
+		m_agents.erase(it);
+	}
+}
+
+bool JuiceManager::has_game_traffic(const NetAddress& address) {
+	std::lock_guard lock{m_mutex};
+	auto agent = maybe_get_agent(address, lock);
+	return agent && agent->has_game_traffic();
+}
+
+void JuiceManager::retire_prewarmed(const NetAddress& address) {
+	std::lock_guard lock{m_mutex};
+	if (auto it = m_agents.find(address); it != m_agents.end() && !it->second->has_game_traffic()) {
+		spdlog::debug("Ending prewarmed session with {}", address.b64());
+		// The host would otherwise keep its side until the idle timeout
+		it->second->send_bye();
+		retire(std::move(it->second));
+		m_agents.erase(it);
+	}
+}
+
 void JuiceManager::handle_signal_packet(const SignalPacket& packet) {
 	const auto& peer = packet.peer_address;
 	spdlog::trace("Received message for {}: {}", peer.b64(), packet.data);
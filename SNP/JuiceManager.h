@@ -1,30 +1,67 @@
 #pragma once
 #include "Common.h"
 #include "JuiceAgent.h"
+#include "AgentReaper.h"
+#include "TimerWheel.h"
 
 struct SignalPacket;
 
 class JuiceManager {
 public:
-	JuiceManager() = default;
+	JuiceManager(TimerWheel& timers) : m_timers{timers} {}
 
 	JuiceAgent* maybe_get_agent(const NetAddress& address, const std::lock_guard<std::mutex>&); 
 	JuiceAgent& ensure_agent(const NetAddress& address, const std::lock_guard<std::mutex>&);
 
-	void clear_inactive_agents();
+	// Lock free, for the juice threads to report a failed connection
+	void request_expiry_check();
+	// Runs callback on the signaling thread under the manager lock, unless the agent is gone by then
+	TimerWheel::TimerId schedule_agent_timer(const JuiceAgent& agent, std::chrono::steady_clock::duration delay,
+		std::function<void(JuiceAgent&, const std::lock_guard<std::mutex>&)> callback);
+	void cancel_timer(TimerWheel::TimerId id) { m_timers.cancel(id); }
+	// Same, but on the task thread and right away, for work a juice callback must not do inline
+	void post_agent_task(const JuiceAgent& agent, std::function<void(JuiceAgent&, const std::lock_guard<std::mutex>&)> callback);
 	void handle_signal_packet(const SignalPacket& packet);
 	void send_p2p(const NetAddress& address, void* data, size_t size);
+	void relay_frame(const NetAddress& destination, const char* frame, size_t size);
 	void send_all(void* data, size_t size);
 	void send_signal_ping(const NetAddress& address);
 	void mark_last_signal(const NetAddress& address);
+	// Says bye over P2P to every peer, returns all of them so signaling can say it too
+	std::vector<NetAddress> send_bye();
+	void disconnect(const NetAddress& address);
+	bool has_game_traffic(const NetAddress& address);
+	// Ends a prewarmed session whose lobby lost its slot, unless Storm has started using it
+	void retire_prewarmed(const NetAddress& address);
 
 	juice_state agent_state(const NetAddress& address);
 	JuiceConnectionType final_connection_type(const NetAddress& address);
 
 	std::mutex& mutex() { return m_mutex; }
+	u64 agents_created() const { return m_agents_created; }
 
 private:
+	JuiceAgent* find_relay(const NetAddress& destination, const std::lock_guard<std::mutex>&);
+	JuiceAgent* start_forwarding(JuiceAgent& agent, const std::lock_guard<std::mutex>& lock);
+	bool awaiting_routes(const JuiceAgent& agent, const std::lock_guard<std::mutex>&);
+	void report_routes(const std::lock_guard<std::mutex>&);
+	void clear_inactive_agents();
+	void schedule_expiry(const JuiceAgent& agent, const std::lock_guard<std::mutex>&);
+	void expire(JuiceAgent& agent, const std::lock_guard<std::mutex>&);
+	void retire(std::unique_ptr<JuiceAgent> agent);
+	void schedule_leave_bye(JuiceAgent& agent, const void* data, size_t size, const std::lock_guard<std::mutex>&);
+
+private:
+	static constexpr u32 ROUTE_WAIT_REPORTS = 3;
+	// Long enough for Storm's repeated leave packets and their acks
+	static constexpr auto LEAVE_BYE_DELAY = 2s;
+
+	TimerWheel& m_timers;
+	AgentReaper m_reaper;
 	std::unordered_map<NetAddress, std::unique_ptr<JuiceAgent>> m_agents;
+	std::atomic<bool> m_check_all_agents = false;
 	std::mutex m_mutex;
 	std::vector<TurnServer> m_turn_servers;
+	std::chrono::steady_clock::time_point m_last_route_report;
+	std::atomic<u64> m_agents_created = 0;
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "Metrics.h"
+#include <bit>
+
+u32 LatencyHistogram::bucket_of(u64 ns) {
+	constexpr u64 SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	if (ns < SUB_BUCKETS) {
+		return (u32)ns;
+	}
+	const u32 msb = 63 - std::countl_zero(ns);
+	const u32 bucket = ((msb - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + (u32)((ns >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+	return std::min(bucket, BUCKETS - 1);
+}
+
+u64 LatencyHistogram::bucket_floor(u32 bucket) {
+	constexpr u64 SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	const u32 msb = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+	return (SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << (msb - SUB_BUCKET_BITS);
+}
+
+void LatencyHistogram::record(s64 ns) {
+	m_counts[bucket_of((u64)std::max<s64>(ns, 0))].fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Counts LatencyHistogram::snapshot() const {
+	Counts counts{};
+	for (u32 i = 0; i < BUCKETS; i++) {
+		counts[i] = m_counts[i].load(std::memory_order_relaxed);
+	}
+	return counts;
+}
+
+f64 LatencyHistogram::percentile_us(const Counts& counts, f64 q) {
+	u64 total = 0;
+	for (const auto count : counts) {
+		total += count;
+	}
+	if (total == 0) {
+		return 0;
+	}
+	const auto rank = (u64)std::ceil(q * total);
+	u64 seen = 0;
+	for (u32 i = 0; i < BUCKETS; i++) {
+		seen += counts[i];
+		if (seen >= std::max<u64>(rank, 1)) {
+			return (i + 1 < BUCKETS ? bucket_floor(i + 1) : bucket_floor(i)) / 1000.0;
+		}
+	}
+	return bucket_floor(BUCKETS - 1) / 1000.0;
+}
+
+std::string LatencyHistogram::summary(const Counts& counts) {
+	u64 total = 0;
+	for (const auto count : counts) {
+		total += count;
+	}
+	return fmt::format("{} packets, p50 {:.1f} us, p90 {:.1f} us, p99 {:.1f} us, p99.9 {:.1f} us", total,
+		percentile_us(counts, 0.5), percentile_us(counts, 0.9), percentile_us(counts, 0.99), percentile_us(counts, 0.999));
+}
+
+void PipelineMetrics::log() const {
+	spdlog::info("Receive latency, processing: {}", LatencyHistogram::summary(processing.snapshot()));
+	spdlog::info("Receive latency, queued for Storm: {}", LatencyHistogram::summary(queued.snapshot()));
+	spdlog::info("Receive latency, total: {}", LatencyHistogram::summary(total.snapshot()));
+}
+
+PipelineMetrics& PipelineMetrics::instance() {
+	static PipelineMetrics metrics;
+	return metrics;
+}
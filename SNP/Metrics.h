@@ -0,0 +1,35 @@
+#pragma once
+#include "Common.h"
+#include <array>
+
+// Log-linear latency histogram: four buckets per power of two nanoseconds, so every bucket is
+// within 25% of its neighbours. Recording is a couple of relaxed atomic adds, safe from any thread.
+class LatencyHistogram {
+public:
+	static constexpr u32 SUB_BUCKET_BITS = 2;
+	static constexpr u32 BUCKETS = 40 << SUB_BUCKET_BITS; // up to 2^40 ns, about 18 minutes
+	using Counts = std::array<u64, BUCKETS>;
+
+	void record(s64 ns);
+	Counts snapshot() const;
+
+	static u32 bucket_of(u64 ns);
+	static u64 bucket_floor(u32 bucket);
+	// Upper edge of the bucket holding the q-th sample, in microseconds
+	static f64 percentile_us(const Counts& counts, f64 q);
+	static std::string summary(const Counts& counts);
+
+private:
+	std::array<std::atomic<u64>, BUCKETS> m_counts{};
+};
+
+// Where received packets spend their time: libjuice hands a datagram over, CrownLink unwraps it
+// (impairment, FEC, decompression) and queues it, then it waits for Storm's spi_receive.
+struct PipelineMetrics {
+	LatencyHistogram processing; // libjuice receive -> receive queue
+	LatencyHistogram queued;     // receive queue -> spi_receive
+	LatencyHistogram total;      // libjuice receive -> spi_receive
+
+	void log() const;
+	static PipelineMetrics& instance();
+};
@@ -0,0 +1,70 @@
+#include "Multipath.h"
+
+void PathSelector::set_usable(PathId path, bool usable) {
+	std::lock_guard lock{m_mutex};
+	auto& state = m_paths[(size_t)path];
+	state.usable = usable;
+	if (usable) {
+		// Give a freshly connected path a full probe round before judging it
+		state.last_sample = Clock::now();
+	}
+	reselect(Clock::now());
+}
+
+void PathSelector::on_rtt_sample(PathId path, Clock::duration rtt) {
+	std::lock_guard lock{m_mutex};
+	auto& state = m_paths[(size_t)path];
+	const auto sample = std::chrono::duration<f64, std::milli>{rtt}.count();
+	state.srtt_ms = state.srtt_ms < 0 ? sample : state.srtt_ms * 0.875 + sample * 0.125;
+	state.last_sample = Clock::now();
+	reselect(state.last_sample);
+}
+
+bool PathSelector::probe_due() {
+	std::lock_guard lock{m_mutex};
+	const auto now = Clock::now();
+	if (now - m_last_probe < std::chrono::milliseconds{m_config.probe_interval_ms}) {
+		return false;
+	}
+	m_last_probe = now;
+	reselect(now);
+	return true;
+}
+
+PathId PathSelector::active() {
+	std::lock_guard lock{m_mutex};
+	return m_active;
+}
+
+bool PathSelector::is_usable(PathId path) {
+	std::lock_guard lock{m_mutex};
+	return is_alive(m_paths[(size_t)path], Clock::now());
+}
+
+f64 PathSelector::rtt_ms(PathId path) {
+	std::lock_guard lock{m_mutex};
+	return m_paths[(size_t)path].srtt_ms;
+}
+
+bool PathSelector::is_alive(const PathState& path, Clock::time_point now) const {
+	return path.usable && now - path.last_sample < std::chrono::milliseconds{m_config.probe_interval_ms * 4};
+}
+
+void PathSelector::reselect(Clock::time_point now) {
+	const auto current = m_active;
+	const auto other = current == PathId::Direct ? PathId::Relay : PathId::Direct;
+	const auto& current_state = m_paths[(size_t)current];
+	const auto& other_state = m_paths[(size_t)other];
+	if (!is_alive(other_state, now)) {
+		return;
+	}
+
+	const bool current_alive = is_alive(current_state, now);
+	const bool other_faster = other_state.srtt_ms >= 0 && current_state.srtt_ms >= 0
+		&& other_state.srtt_ms + m_config.switch_margin_ms < current_state.srtt_ms;
+	if (!current_alive || other_faster) {
+		m_active = other;
+		spdlog::info("Switching to {} path, rtt {:.1f} ms vs {:.1f} ms{}", to_string(other), other_state.srtt_ms,
+			current_state.srtt_ms, current_alive ? "" : " (current path stopped responding)");
+	}
+}
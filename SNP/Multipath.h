@@ -0,0 +1,77 @@
+#pragma once
+#include "Common.h"
+
+enum class MultipathMode {
+	Fastest, // send on the path with the lowest measured RTT
+	Both     // send on both paths, the receiver drops whichever copy comes second
+};
+
+NLOHMANN_JSON_SERIALIZE_ENUM(MultipathMode, {
+	{MultipathMode::Fastest, "fastest"},
+	{MultipathMode::Both, "both"},
+})
+
+inline std::string to_string(MultipathMode value) {
+	switch (value) {
+		EnumStringCase(MultipathMode::Fastest);
+		EnumStringCase(MultipathMode::Both);
+	}
+	return std::to_string((s32)value);
+}
+
+struct MultipathConfig {
+	bool enabled = false;
+	MultipathMode mode = MultipathMode::Fastest;
+	u32 probe_interval_ms = 250;
+	u32 switch_margin_ms = 10; // the other path must be this much faster before switching to it
+};
+
+enum class PathId : u8 {
+	Direct, // the agent's normal ICE session
+	Relay,  // a second session, restricted to relay candidates when TURN servers are known
+};
+
+constexpr size_t PATH_COUNT = 2;
+
+inline std::string to_string(PathId value) {
+	switch (value) {
+		EnumStringCase(PathId::Direct);
+		EnumStringCase(PathId::Relay);
+	}
+	return std::to_string((s32)value);
+}
+
+// Tracks the RTT of both paths from probe replies and picks the one to send on. A path that
+// stops answering probes is treated as down even if ICE still reports it connected.
+class PathSelector {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	PathSelector(const MultipathConfig& config) : m_config{config} {}
+
+	void set_usable(PathId path, bool usable);
+	void on_rtt_sample(PathId path, Clock::duration rtt);
+	// True at most once per probe interval
+	bool probe_due();
+
+	PathId active();
+	bool is_usable(PathId path);
+	f64 rtt_ms(PathId path);
+
+private:
+	struct PathState {
+		bool usable = false;
+		f64 srtt_ms = -1;
+		Clock::time_point last_sample{};
+	};
+
+	bool is_alive(const PathState& path, Clock::time_point now) const;
+	void reselect(Clock::time_point now);
+
+private:
+	const MultipathConfig m_config;
+	PathState m_paths[PATH_COUNT];
+	PathId m_active = PathId::Direct;
+	Clock::time_point m_last_probe{};
+	std::mutex m_mutex;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "Common.h"
+
+// CrownLink's own frames on the P2P channel, sent alongside raw Storm packets.
+// A Storm packet starts with its checksum and total size, a size of 0xffff can never be a real
+// Storm packet (they are at most 512 bytes), so that is the marker telling frames apart.
+
+// 1: Hello carries version and a feature byte, 2: Hello carries PeerCapabilities
+constexpr u8 PEER_PROTOCOL_VERSION = 2;
+constexpr u16 FRAME_MAGIC = 'L' << 8 | 'C';
+constexpr u16 FRAME_MARKER = 0xffff;
+constexpr size_t MAX_FRAME_SIZE = 1024;
+constexpr size_t MAX_FRAME_PAYLOAD = 512;
+// Largest frame payload a peer takes unless its Hello says otherwise, a full frame minus the header
+constexpr u16 MAX_PEER_PAYLOAD = MAX_FRAME_SIZE - 8;
+
+enum class FrameType : u8 {
+	Hello = 1,   // "I understand frames" and PeerCapabilities, sent once connected
+	Data,        // a Storm packet with a transport sequence number
+	Parity,      // XOR of a group of Data frames, recovers a single loss
+	LossReport,  // receiver measured loss, lets the sender adapt
+	Compressed,  // a compressed Storm packet, the sequence holds its original size
+	Probe,       // RTT probe for one path, echoed back with FRAME_FLAG_REPLY
+	Forward,     // a Storm packet relayed for a pair of peers that could not connect, see Forwarding.h
+	Routes,      // the peers the sender reaches directly and its RTT to them
+	Bye,         // the sender is leaving, the session can be torn down right away
+};
+
+enum FrameFlags : u8 {
+	FRAME_FLAG_REPLY = 0x01,
+};
+
+// Optional features, advertised in the Hello. One is only used when both peers announce it,
+// so a new feature can be added without breaking older clients in the same lobby.
+enum PeerFeatures : u32 {
+	PEER_FEATURE_COMPRESSION = 0x01,
+	PEER_FEATURE_MULTIPATH = 0x02,
+	PEER_FEATURE_FORWARDING = 0x04,
+};
+
+#pragma pack(push, 1)
+struct FrameHeader {
+	u16 magic = FRAME_MAGIC;
+	u16 marker = FRAME_MARKER;
+	FrameType type{};
+	u8 flags = 0;
+	u16 sequence = 0;
+};
+
+// Version 1 peers only send the first two bytes, new fields are only ever appended and whatever
+// an older peer leaves out keeps its default
+struct PeerCapabilities {
+	u8 version = 1;
+	u8 legacy_features = 0; // the low byte of features, all a version 1 peer reads
+	u16 max_payload = MAX_PEER_PAYLOAD; // largest frame payload the sender accepts
+	u8 mode = 0;            // CrownLinkMode
+	u32 features = 0;
+};
+
+struct ProbePayload {
+	u8 path;
+	s64 sent_ns; // sender's clock, only compared against itself
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FrameHeader) == 8);
+static_assert(sizeof(PeerCapabilities) == 9);
+
+inline PeerCapabilities read_capabilities(const char* payload, size_t size) {
+	PeerCapabilities capabilities;
+	memcpy(&capabilities, payload, std::min(size, sizeof(capabilities)));
+	if (size < offsetof(PeerCapabilities, features) + sizeof(capabilities.features)) {
+		capabilities.features = capabilities.legacy_features;
+	}
+	return capabilities;
+}
+
+inline bool is_frame(const char* data, size_t size) {
+	if (size < sizeof(FrameHeader)) {
+		return false;
+	}
+	FrameHeader header;
+	memcpy(&header, data, sizeof(header));
+	return header.magic == FRAME_MAGIC && header.marker == FRAME_MARKER;
+}
+
+// Writes header + payload into out, returns the frame size
+inline size_t write_frame(char* out, FrameType type, u8 flags, u16 sequence, const char* payload = nullptr, size_t size = 0) {
+	const FrameHeader header{.type = type, .flags = flags, .sequence = sequence};
+	memcpy(out, &header, sizeof(header));
+	if (size) {
+		memcpy(out + sizeof(header), payload, size);
+	}
+	return sizeof(header) + size;
+}
@@ -0,0 +1,93 @@
+#include "Platform.h"
+
+namespace platform {
+
+#ifdef _WIN32
+
+s32 socket_startup() {
+	WSADATA wsa_data{};
+	return WSAStartup(MAKEWORD(2, 2), &wsa_data);
+}
+
+void socket_cleanup() {
+	WSACleanup();
+}
+
+void close_socket(SOCKET socket) {
+	closesocket(socket);
+}
+
+s32 last_socket_error() {
+	return WSAGetLastError();
+}
+
+u32 tick_count() {
+	return GetTickCount();
+}
+
+void signal_event(HANDLE event) {
+	SetEvent(event);
+}
+
+fs::path executable_dir() {
+	wchar_t buffer[MAX_PATH];
+	GetModuleFileNameW(0, buffer, MAX_PATH);
+	return fs::path{buffer}.parent_path();
+}
+
+#else
+
+void Event::set() {
+	{
+		std::lock_guard lock{m_mutex};
+		m_signaled = true;
+	}
+	m_cv.notify_one();
+}
+
+bool Event::wait_for(std::chrono::milliseconds timeout) {
+	std::unique_lock lock{m_mutex};
+	const bool signaled = m_cv.wait_for(lock, timeout, [this] { return m_signaled; });
+	m_signaled = false;
+	return signaled;
+}
+
+s32 socket_startup() {
+	return 0;
+}
+
+void socket_cleanup() {}
+
+void close_socket(SOCKET socket) {
+	close(socket);
+}
+
+s32 last_socket_error() {
+	return errno;
+}
+
+u32 tick_count() {
+	using namespace std::chrono;
+	return (u32)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void signal_event(HANDLE event) {
+	if (event) {
+		static_cast<Event*>(event)->set();
+	}
+}
+
+fs::path executable_dir() {
+	std::error_code ec;
+	auto path = fs::read_symlink("/proc/self/exe", ec);
+	return ec ? fs::current_path() : path.parent_path();
+}
+
+#endif
+
+s64 steady_ns() {
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+}
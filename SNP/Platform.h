@@ -0,0 +1,65 @@
+#pragma once
+#include "../shared_common.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <condition_variable>
+
+// Storm's interface is declared with win32 types, keep them available so the core builds everywhere
+using DWORD = u32;
+using BOOL = s32;
+using HANDLE = void*;
+using SOCKET = s32;
+
+#define __stdcall
+#define WINAPI
+#endif
+
+#ifdef _MSC_VER
+#define CL_FUNCSIG __FUNCSIG__
+#else
+#define CL_FUNCSIG __PRETTY_FUNCTION__
+#endif
+
+namespace platform {
+
+#ifndef _WIN32
+// Stand-in for a win32 auto-reset event, used as the receive event outside of Storm
+class Event {
+public:
+	void set();
+	bool wait_for(std::chrono::milliseconds timeout);
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_signaled = false;
+};
+#endif
+
+// Returns WSAStartup's error code, WSAGetLastError is not valid when it fails
+s32 socket_startup();
+void socket_cleanup();
+void close_socket(SOCKET socket);
+s32 last_socket_error();
+
+// Milliseconds since boot, wraps like GetTickCount
+u32 tick_count();
+// Monotonic, high resolution and never wraps, for packet timestamps and latency
+s64 steady_ns();
+void signal_event(HANDLE event);
+fs::path executable_dir();
+
+}
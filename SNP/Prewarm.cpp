@@ -0,0 +1,92 @@
+#include "Prewarm.h"
+
+constexpr u32 GAME_IN_PROGRESS = 12;
+
+void PrewarmPlanner::on_solicit(const NetAddress& host) {
+	std::lock_guard lock{m_mutex};
+	m_lobbies[host].last_solicit = Clock::now();
+}
+
+bool PrewarmPlanner::on_ad(const NetAddress& host, const AdFile& ad) {
+	std::lock_guard lock{m_mutex};
+	const auto now = Clock::now();
+	auto& lobby = m_lobbies[host];
+	if (lobby.last_solicit > lobby.last_ad) {
+		const auto sample = std::chrono::duration<f64, std::milli>{now - lobby.last_solicit}.count();
+		lobby.latency_ms = lobby.latency_ms < 0 ? sample : lobby.latency_ms * 0.75 + sample * 0.25;
+	}
+	lobby.last_ad = now;
+	lobby.open = ad.game_info.game_state != GAME_IN_PROGRESS;
+
+	update_selection(now);
+	return lobby.selected;
+}
+
+bool PrewarmPlanner::is_selected(const NetAddress& host) {
+	std::lock_guard lock{m_mutex};
+	auto it = m_lobbies.find(host);
+	return it != m_lobbies.end() && it->second.selected;
+}
+
+std::vector<NetAddress> PrewarmPlanner::take_dropped() {
+	std::lock_guard lock{m_mutex};
+	// Ads may have stopped altogether, so look at the lobbies again first
+	update_selection(Clock::now());
+	// A lobby can win its slot back before anyone asked
+	std::erase_if(m_dropped, [this](const NetAddress& host) {
+		auto it = m_lobbies.find(host);
+		return it != m_lobbies.end() && it->second.selected;
+	});
+	return std::exchange(m_dropped, {});
+}
+
+bool PrewarmPlanner::is_candidate(const Lobby& lobby, Clock::time_point now) const {
+	return lobby.open && now - lobby.last_ad < std::chrono::milliseconds{m_config.ad_timeout_ms};
+}
+
+void PrewarmPlanner::update_selection(Clock::time_point now) {
+	u32 selected = 0;
+	std::vector<std::pair<const NetAddress*, Lobby*>> candidates;
+	for (auto it = m_lobbies.begin(); it != m_lobbies.end();) {
+		auto& [host, lobby] = *it;
+		if (now - std::max(lobby.last_ad, lobby.last_solicit) > 10 * std::chrono::milliseconds{m_config.ad_timeout_ms}) {
+			if (lobby.selected) {
+				m_dropped.push_back(host);
+			}
+			it = m_lobbies.erase(it);
+			continue;
+		}
+		if (lobby.selected && !is_candidate(lobby, now)) {
+			spdlog::debug("Prewarm: dropping {}, lobby {}", host.b64(), lobby.open ? "went quiet" : "started");
+			lobby.selected = false;
+			m_dropped.push_back(host);
+		}
+		if (lobby.selected) {
+			selected++;
+		} else if (is_candidate(lobby, now)) {
+			candidates.emplace_back(&host, &lobby);
+		}
+		++it;
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+		const auto& left = *a.second;
+		const auto& right = *b.second;
+		if ((left.latency_ms < 0) != (right.latency_ms < 0)) {
+			return right.latency_ms < 0;
+		}
+		if (left.latency_ms != right.latency_ms) {
+			return left.latency_ms < right.latency_ms;
+		}
+		return left.last_ad > right.last_ad;
+	});
+
+	for (auto& [host, lobby] : candidates) {
+		if (selected >= m_config.max_sessions) {
+			break;
+		}
+		spdlog::debug("Prewarm: starting ICE with {}, ad latency {:.0f} ms", host->b64(), lobby->latency_ms);
+		lobby->selected = true;
+		selected++;
+	}
+}
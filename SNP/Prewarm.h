@@ -0,0 +1,46 @@
+#pragma once
+#include "Common.h"
+
+struct PrewarmConfig {
+	bool enabled = false;
+	u32 max_sessions = 4;       // ICE sessions started speculatively while browsing
+	u32 ad_timeout_ms = 10'000; // lobbies without a fresh ad stop being candidates
+};
+
+// Picks the lobbies that get an ICE session while the player is still browsing, so joining one
+// does not wait for gathering and the candidate exchange. Open lobbies are ranked by the
+// round trip of their ad solicitation through the server, newest ad first on ties. A lobby keeps
+// its slot until its ad goes stale or its game starts, so sessions are not torn down and
+// restarted while the list refreshes. Lobbies that lose their slot are handed back through
+// take_dropped so their session can be ended, max_sessions bounds the live sessions that way.
+class PrewarmPlanner {
+public:
+	PrewarmPlanner(const PrewarmConfig& config) : m_config{config} {}
+
+	void on_solicit(const NetAddress& host);
+	// Returns true if the lobby should have a warm session
+	bool on_ad(const NetAddress& host, const AdFile& ad);
+	bool is_selected(const NetAddress& host);
+	// Lobbies that lost their slot since the last call
+	std::vector<NetAddress> take_dropped();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Lobby {
+		Clock::time_point last_solicit{};
+		Clock::time_point last_ad{};
+		f64 latency_ms = -1;
+		bool open = false;
+		bool selected = false;
+	};
+
+	void update_selection(Clock::time_point now);
+	bool is_candidate(const Lobby& lobby, Clock::time_point now) const;
+
+private:
+	const PrewarmConfig m_config;
+	std::unordered_map<NetAddress, Lobby> m_lobbies;
+	std::vector<NetAddress> m_dropped;
+	std::mutex m_mutex;
+};
@@ -0,0 +1,24 @@
+#include "ReceiveQueue.h"
+
+void ReceiveQueue::push(GamePacket packet) {
+	packet.queued_ns = platform::steady_ns();
+	PipelineMetrics::instance().processing.record(packet.queued_ns - packet.received_ns);
+	m_queue.enqueue(std::move(packet));
+	m_pushed.fetch_add(1, std::memory_order_relaxed);
+	if (!m_wake_pending.exchange(true)) {
+		m_wakeups.fetch_add(1, std::memory_order_relaxed);
+		m_wake();
+	}
+}
+
+bool ReceiveQueue::try_pop(GamePacket& out) {
+	if (m_queue.try_dequeue(out)) {
+		return true;
+	}
+	// A producer that saw the flag still set skipped the wakeup, its packet is already visible to the
+	// exchange here, so look once more. Whatever comes after this wakes the consumer again.
+	if (!m_wake_pending.exchange(false)) {
+		return false;
+	}
+	return m_queue.try_dequeue(out);
+}
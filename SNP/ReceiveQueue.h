@@ -0,0 +1,30 @@
+#pragma once
+#include "Common.h"
+#include "Metrics.h"
+#include <functional>
+
+// Packets waiting for Storm's spi_receive. Storm drains the queue every time the receive event is
+// set, so the event is only set when the queue goes from empty to non-empty instead of per packet.
+class ReceiveQueue {
+public:
+	ReceiveQueue(std::function<void()> wake) : m_wake{std::move(wake)} {}
+
+	ReceiveQueue(const ReceiveQueue&) = delete;
+	ReceiveQueue& operator=(const ReceiveQueue&) = delete;
+
+	// Any thread
+	void push(GamePacket packet);
+	// Storm's thread only, false once the queue is empty
+	bool try_pop(GamePacket& out);
+
+	u64 pushed() const { return m_pushed; }
+	u64 wakeups() const { return m_wakeups; }
+
+private:
+	moodycamel::ConcurrentQueue<GamePacket> m_queue;
+	std::function<void()> m_wake;
+	// Set by the producer that wakes the consumer, cleared once the consumer found the queue empty
+	std::atomic<bool> m_wake_pending = false;
+	std::atomic<u64> m_pushed = 0;
+	std::atomic<u64> m_wakeups = 0;
+};
@@ -0,0 +1,151 @@
+#include "Reorder.h"
+#include "TaskScheduler.h"
+
+// A peer that restarted its numbering looks this far behind, it is followed from there on
+constexpr s16 RESYNC_DISTANCE = 1024;
+
+static s16 distance(u16 from, u16 to) {
+	return (s16)(u16)(to - from);
+}
+
+void ReorderBuffer::process(const char* data, size_t size, s64 received_ns) {
+	const StormPacketView packet{data, size};
+	const auto packet_class = packet.classify();
+	std::lock_guard lock{m_mutex};
+	if (m_closed) {
+		return;
+	}
+	// Acks and resend requests carry no sequence number of their own
+	if (packet_class == StormPacketClass::Invalid || packet_class == StormPacketClass::Ack || packet_class == StormPacketClass::ResendRequest) {
+		m_deliver(data, size, received_ns);
+		return;
+	}
+
+	const auto now = Clock::now();
+	auto& stream = m_streams[(u16)(packet.player_id() << 8 | (u8)packet.type())];
+	const auto sequence = packet.sequence();
+	if (!stream.started) {
+		stream.started = true;
+		stream.next = sequence;
+	}
+	if (is_duplicate(stream, packet, now)) {
+		m_stats.duplicates++;
+		return;
+	}
+
+	const auto ahead = distance(stream.next, sequence);
+	if (ahead < -RESYNC_DISTANCE) {
+		while (!stream.held.empty()) {
+			skip_gap(stream);
+		}
+		stream.next = sequence;
+	} else if (ahead < 0) {
+		m_stats.late++;
+		deliver(stream, data, size, received_ns, sequence, packet.checksum());
+		return;
+	}
+	if (stream.next == sequence) {
+		m_stats.in_order++;
+		deliver(stream, data, size, received_ns, sequence, packet.checksum());
+		stream.next++;
+		drain(stream);
+		return;
+	}
+
+	auto it = std::find_if(stream.held.begin(), stream.held.end(), [&](const Held& held) {
+		return distance(stream.next, held.sequence) > ahead;
+	});
+	stream.held.insert(it, Held{sequence, std::string{data, size}, received_ns, now});
+	m_stats.max_depth = std::max<u64>(m_stats.max_depth, stream.held.size());
+	if (stream.held.size() > m_config.max_depth) {
+		skip_gap(stream);
+	}
+	if (!stream.held.empty()) {
+		schedule_flush(now + std::chrono::milliseconds{m_config.hold_ms}, lock);
+	}
+}
+
+// Both paths with multipath, FEC duplicates and the impairment all produce exact copies shortly after
+bool ReorderBuffer::is_duplicate(Stream& stream, const StormPacketView& packet, Clock::time_point now) {
+	const auto window = std::chrono::milliseconds{m_config.duplicate_window_ms};
+	for (const auto& recent : stream.recent) {
+		if (recent.sequence == packet.sequence() && recent.checksum == packet.checksum() && now - recent.at < window) {
+			return true;
+		}
+	}
+	return std::any_of(stream.held.begin(), stream.held.end(), [&](const Held& held) {
+		return held.sequence == packet.sequence();
+	});
+}
+
+void ReorderBuffer::deliver(Stream& stream, const char* data, size_t size, s64 received_ns, u16 sequence, u16 checksum) {
+	stream.recent[stream.recent_index] = Recent{sequence, checksum, Clock::now()};
+	stream.recent_index = (stream.recent_index + 1) % stream.recent.size();
+	m_deliver(data, size, received_ns);
+}
+
+// Passes on the held packets that directly follow what was delivered
+void ReorderBuffer::drain(Stream& stream) {
+	size_t count = 0;
+	while (count < stream.held.size() && stream.held[count].sequence == stream.next) {
+		auto& held = stream.held[count];
+		m_stats.held++;
+		deliver(stream, held.data.data(), held.data.size(), held.received_ns, held.sequence, StormPacketView{held.data.data(), held.data.size()}.checksum());
+		stream.next++;
+		count++;
+	}
+	stream.held.erase(stream.held.begin(), stream.held.begin() + count);
+}
+
+// Skips the gap before the first held packet, Storm asks for whatever was in it
+void ReorderBuffer::skip_gap(Stream& stream) {
+	stream.next = stream.held.front().sequence;
+	m_stats.gaps_skipped++;
+	drain(stream);
+}
+
+void ReorderBuffer::schedule_flush(Clock::time_point due, const std::lock_guard<std::mutex>&) {
+	if (due >= m_flush_due) {
+		return;
+	}
+	m_flush_due = due;
+	TaskScheduler::instance().schedule(due, [weak = weak_from_this()] {
+		if (auto self = weak.lock()) {
+			self->flush();
+		}
+	});
+}
+
+void ReorderBuffer::flush() {
+	std::lock_guard lock{m_mutex};
+	if (m_closed) {
+		return;
+	}
+	const auto now = Clock::now();
+	const auto hold = std::chrono::milliseconds{m_config.hold_ms};
+	auto next_due = Clock::time_point::max();
+	const auto expired = [&](const Held& held) { return now - held.since >= hold; };
+	for (auto& [_, stream] : m_streams) {
+		// A later packet may have been waiting longer than the first one, everything up to it goes
+		while (std::any_of(stream.held.begin(), stream.held.end(), expired)) {
+			skip_gap(stream);
+		}
+		for (const auto& held : stream.held) {
+			next_due = std::min(next_due, held.since + hold);
+		}
+	}
+	m_flush_due = Clock::time_point::max();
+	if (next_due != Clock::time_point::max()) {
+		schedule_flush(next_due, lock);
+	}
+}
+
+void ReorderBuffer::close() {
+	std::lock_guard lock{m_mutex};
+	m_closed = true;
+}
+
+ReorderStats ReorderBuffer::stats() {
+	std::lock_guard lock{m_mutex};
+	return m_stats;
+}
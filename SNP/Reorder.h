@@ -0,0 +1,79 @@
+#pragma once
+#include "Common.h"
+#include "../NetShared/StormPacket.h"
+#include <functional>
+
+struct ReorderConfig {
+	bool enabled = false;
+	u32 hold_ms = 10;              // longest a packet waits for the ones before it
+	u32 max_depth = 32;            // packets held per peer before the oldest gap is given up on
+	u32 duplicate_window_ms = 50;  // a copy within this window is a network duplicate, Storm's own resends come later
+};
+
+struct ReorderStats {
+	u64 in_order = 0;
+	u64 held = 0;         // arrived early and waited for the packets before them
+	u64 gaps_skipped = 0; // gaps given up on after hold_ms or max_depth, Storm asks for those packets itself
+	u64 late = 0;         // arrived after their gap was skipped, passed straight to Storm
+	u64 duplicates = 0;
+	u64 max_depth = 0;
+};
+
+// Puts a peer's Storm packets back in order before Storm sees them. Storm numbers every packet
+// carrying data per player and type, a gap makes it ask for a resend, costing a round trip even when
+// the packet was only overtaken. Packets after a gap wait up to hold_ms for it to fill.
+// Lives in a shared_ptr so a pending flush on the task thread can outlive the agent.
+class ReorderBuffer : public std::enable_shared_from_this<ReorderBuffer> {
+public:
+	using Clock = std::chrono::steady_clock;
+	using Deliver = std::function<void(const char* data, size_t size, s64 received_ns)>;
+
+	ReorderBuffer(const ReorderConfig& config, Deliver deliver) : m_config{config}, m_deliver{std::move(deliver)} {}
+
+	ReorderBuffer(const ReorderBuffer&) = delete;
+	ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+	void process(const char* data, size_t size, s64 received_ns);
+	// Stops delivering, must be called before whatever deliver refers to goes away
+	void close();
+	ReorderStats stats();
+
+private:
+	struct Held {
+		u16 sequence;
+		std::string data;
+		s64 received_ns;
+		Clock::time_point since;
+	};
+
+	struct Recent {
+		u16 sequence;
+		u16 checksum;
+		Clock::time_point at;
+	};
+
+	// One per player and Storm type, each has its own sequence numbers
+	struct Stream {
+		bool started = false;
+		u16 next = 0;
+		std::vector<Held> held; // sorted by distance from next
+		std::array<Recent, 16> recent{};
+		size_t recent_index = 0;
+	};
+
+	bool is_duplicate(Stream& stream, const StormPacketView& packet, Clock::time_point now);
+	void deliver(Stream& stream, const char* data, size_t size, s64 received_ns, u16 sequence, u16 checksum);
+	void drain(Stream& stream);
+	void skip_gap(Stream& stream);
+	void schedule_flush(Clock::time_point due, const std::lock_guard<std::mutex>&);
+	void flush();
+
+private:
+	const ReorderConfig m_config;
+	Deliver m_deliver;
+	std::unordered_map<u16, Stream> m_streams;
+	ReorderStats m_stats;
+	Clock::time_point m_flush_due = Clock::time_point::max();
+	bool m_closed = false;
+	std::mutex m_mutex;
+};
@@ -2,6 +2,7 @@
 
 #include "CrownLink.h"
 #include <list>
+#include <unordered_set>
 
 namespace snp {
 
@@ -11,6 +12,13 @@ struct SNPContext {
 	std::list<AdFile> game_list;
 	s32 next_game_ad_id = 1;
 
+	// A listed lobby disappears once its host stops answering solicitations for this long
+	static constexpr auto AD_TIMEOUT = 2s;
+	std::unordered_map<NetAddress, TimerWheel::TimerId> ad_expiries;
+	// Storm walks the list between spi_lock_game_list and spi_unlock_game_list, so expired ads
+	// are only erased in the next spi_lock_game_list
+	std::unordered_set<NetAddress> expired_ads;
+
 	AdFile hosted_game;
 	AdFile status_ad;
 	bool   status_ad_used = false;
@@ -29,6 +37,7 @@ void pass_advertisement(const NetAddress& host, AdFile& ad) {
 		}
 	}
 
+	g_snp_context.expired_ads.erase(host);
 	if (!adFile) {
 		adFile = &g_snp_context.game_list.emplace_back();
 		ad.game_info.game_index = ++g_snp_context.next_game_ad_id;
@@ -36,7 +45,7 @@ void pass_advertisement(const NetAddress& host, AdFile& ad) {
 		ad.game_info.game_index = adFile->game_info.game_index;
 	}
 
-	memcpy_s(adFile, sizeof(AdFile), &ad, sizeof(AdFile));
+	*adFile = ad;
 
 	std::string prefix;
 	if (g_snp_context.game_app_info.version_id != adFile->game_info.version_id) {
@@ -79,15 +88,27 @@ void pass_advertisement(const NetAddress& host, AdFile& ad) {
 		//prefix += " ";
 		prefix += adFile->game_info.game_name;
 		if (prefix.size() > 127) { prefix.resize(127); }
-		strncpy_s(adFile->game_info.game_name, sizeof(adFile->game_info.game_name), prefix.c_str(), sizeof(adFile->game_info.game_name));
+		snprintf(adFile->game_info.game_name, sizeof(adFile->game_info.game_name), "%s", prefix.c_str());
 	}
 
-	adFile->game_info.host_last_time = GetTickCount();
+	adFile->game_info.host_last_time = platform::tick_count();
 	adFile->game_info.host = *(NetAddress*)&host;
 	adFile->game_info.pExtra = adFile->extra_bytes;
+
+	auto& timers = g_crown_link->timers();
+	auto& expiry = g_snp_context.ad_expiries[host];
+	timers.cancel(expiry);
+	expiry = timers.schedule(SNPContext::AD_TIMEOUT, [host] { remove_advertisement(host); });
 }
 
-void remove_advertisement(const NetAddress& host) {}
+void remove_advertisement(const NetAddress& host) {
+	std::lock_guard lock{g_advertisement_mutex};
+	g_snp_context.expired_ads.insert(host);
+	if (auto it = g_snp_context.ad_expiries.find(host); it != g_snp_context.ad_expiries.end()) {
+		g_crown_link->timers().cancel(it->second);
+		g_snp_context.ad_expiries.erase(it);
+	}
+}
 
 void pass_packet(GamePacket& packet) {}
 
@@ -95,11 +116,11 @@ static void init_logging() {
 	const auto& snp_config = SnpConfig::instance();
 	spdlog::init_thread_pool(8192, 1);
 
-	const auto log_filename = (g_starcraft_dir / "crownlink_logs" / "CrownLink.txt").generic_wstring();
+	const auto log_filename = (g_starcraft_dir / "crownlink_logs" / "CrownLink.txt").native();
 	auto standard_sink = std::make_shared<spdlog::sinks::daily_file_sink_mt>(log_filename, 2, 30);
 	standard_sink->set_level(spdlog::level::debug);
 
-	const auto trace_filename = (g_starcraft_dir / "crownlink_logs" / "CLTrace.txt").generic_wstring();
+	const auto trace_filename = (g_starcraft_dir / "crownlink_logs" / "CLTrace.txt").native();
 	auto trace_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(trace_filename, 1024*1024*10, 3);
 	trace_sink->set_level(spdlog::level::trace);
 
@@ -152,7 +173,7 @@ static BOOL __stdcall spi_initialize(client_info* client_info, user_info* user_i
 		g_crown_link = std::make_unique<CrownLink>();
 		g_crown_link->set_mode(mode);
 	} catch (const std::exception& e) {
-		spdlog::error("Unhandled error {} in {}", e.what(), __FUNCSIG__);
+		spdlog::error("Unhandled error {} in {}", e.what(), CL_FUNCSIG);
 		return false;
 	}
 
@@ -163,9 +184,16 @@ static BOOL __stdcall spi_destroy() {
 	try {
 		g_crown_link.reset();
 	} catch (const std::exception& e) {
-		spdlog::error("Unhandled error {} in {}", e.what(), __FUNCSIG__);
+		spdlog::error("Unhandled error {} in {}", e.what(), CL_FUNCSIG);
 		return false;
 	}
+	{
+		// The expiry timers went with the wheel, the next CrownLink starts over with an empty list
+		std::lock_guard lock{g_advertisement_mutex};
+		g_snp_context.game_list.clear();
+		g_snp_context.ad_expiries.clear();
+		g_snp_context.expired_ads.clear();
+	}
 	spdlog::shutdown();
 
 	return true;
@@ -174,7 +202,10 @@ static BOOL __stdcall spi_destroy() {
 static BOOL __stdcall spi_lock_game_list(int, int, game** out_game_list) {
 	std::lock_guard lock{g_advertisement_mutex};
 
-	std::erase_if(g_snp_context.game_list, [now = GetTickCount()](const auto& current_ad) { return now > current_ad.game_info.host_last_time + 2000; });
+	std::erase_if(g_snp_context.game_list, [](const AdFile& ad) {
+		return g_snp_context.expired_ads.contains(ad.game_info.host);
+	});
+	g_snp_context.expired_ads.clear();
 
 	AdFile* last_ad = nullptr;
 	for (auto& game : g_snp_context.game_list) {
@@ -205,7 +236,7 @@ static BOOL __stdcall spi_lock_game_list(int, int, game** out_game_list) {
 		}
 	} catch (const std::exception& e) {
 		spdlog::dump_backtrace();
-		spdlog::error("unhandled error {} in {}", e.what(), __FUNCSIG__);
+		spdlog::error("unhandled error {} in {}", e.what(), CL_FUNCSIG);
 		return false;
 	}
 	return true;
@@ -216,7 +247,7 @@ static BOOL __stdcall spi_unlock_game_list(game* game_list, DWORD*) {
 		g_crown_link->request_advertisements();
 	} catch (const std::exception& e) {
 		spdlog::dump_backtrace();
-		spdlog::error("unhandled error {} in {}", e.what(), __FUNCSIG__);
+		spdlog::error("unhandled error {} in {}", e.what(), CL_FUNCSIG);
 		return false;
 	}
 
@@ -227,8 +258,8 @@ static void create_ad(AdFile& ad_file, const char* game_name, const char* game_s
 	memset(&ad_file, 0, sizeof(ad_file));
 	ad_file.crownlink_mode = g_crown_link->mode();
 	auto& game_info = ad_file.game_info;
-	strcpy_s(game_info.game_name, sizeof(game_info.game_name), game_name);
-	strcpy_s(game_info.game_description, sizeof(game_info.game_description), game_stat_string);
+	snprintf(game_info.game_name, sizeof(game_info.game_name), "%s", game_name);
+	snprintf(game_info.game_description, sizeof(game_info.game_description), "%s", game_stat_string);
 	game_info.game_state = game_state;
 	game_info.program_id = g_snp_context.game_app_info.program_id;
 	game_info.version_id = g_snp_context.game_app_info.version_id;
@@ -272,7 +303,7 @@ static BOOL __stdcall spi_get_game_info(DWORD index, char* game_name, int, game*
 	std::lock_guard lock{g_advertisement_mutex};
 
 	for (auto& game : g_snp_context.game_list) {
-		if (game.game_info.game_index == index) {
+		if (game.game_info.game_index == index && !g_snp_context.expired_ads.contains(game.game_info.host)) {
 			*out_game = game.game_info;
 			return true;
 		}
@@ -296,7 +327,7 @@ static BOOL __stdcall spi_send(DWORD address_count, NetAddress** out_address_lis
 		spdlog::trace("spiSend to {}: {:pa}", peer.b64(), spdlog::to_hex(std::string{data, size}));
 		g_crown_link->send(peer, data, size);
 	} catch (const std::exception& e) {
-		spdlog::error("unhandled error {} in {}", e.what(), __FUNCSIG__);
+		spdlog::error("unhandled error {} in {}", e.what(), CL_FUNCSIG);
 		return false;
 	}
 	return true;
@@ -307,29 +338,35 @@ static BOOL __stdcall spi_receive(NetAddress** peer, char** out_data, DWORD* out
 	*out_data = nullptr;
 	*out_size = 0;
 
-	GamePacket* loan = new GamePacket{};
+	GamePacket packet;
 	try {
 		while (true) {
-			if (!g_crown_link->receive_queue().try_dequeue(*loan)) {
+			if (!g_crown_link->receive_queue().try_pop(packet)) {
 				return false;
 			}
-			std::string debug_string{loan->data, loan->size};
-			// spdlog::trace("spiReceive: {} :: {}", loan->timestamp, debug_string);
-			spdlog::trace("spiRecv fr {}: {:pa}", loan->sender.b64(), spdlog::to_hex(std::string{ loan->data,loan->size }));
-			if (GetTickCount() > loan->timestamp + 10000) {
+			if (spdlog::should_log(spdlog::level::trace)) {
+				spdlog::trace("spiRecv fr {}: {:pa}", packet.sender.b64(), spdlog::to_hex(std::string{ packet.data,packet.size }));
+			}
+			const auto now = platform::steady_ns();
+			if (now - packet.received_ns > 10'000'000'000) {
 				continue;
 			}
+			auto& metrics = PipelineMetrics::instance();
+			metrics.queued.record(now - packet.queued_ns);
+			metrics.total.record(now - packet.received_ns);
 
+			// Only allocated once there is a packet for Storm, it hands it back to spi_free
+			auto loan = std::make_unique<GamePacket>(packet);
 			*peer = &loan->sender;
 			*out_data = loan->data;
 			*out_size = loan->size;
+			loan.release();
 
 			break;
 		}
 	} catch (std::exception& e) {
-		delete loan;
 		spdlog::dump_backtrace();
-		spdlog::error("unhandled error {} in {}", e.what(), __FUNCSIG__);
+		spdlog::error("unhandled error {} in {}", e.what(), CL_FUNCSIG);
 		return false;
 	}
 	return true;
@@ -337,7 +374,7 @@ static BOOL __stdcall spi_receive(NetAddress** peer, char** out_data, DWORD* out
 
 static BOOL __stdcall spi_free(NetAddress* loan, char* data, DWORD size) {
 	if (loan) {
-		delete loan;
+		delete (GamePacket*)loan; // the sender is GamePacket's first member, see spi_receive
 	}
 	return true;
 }
@@ -410,21 +447,21 @@ snp::NetFunctions g_spi_functions = {
 	  &snp::spi_destroy,
 	  &snp::spi_free,
 /*e*/ &snp::spi_free_external_message,
-      &snp::spi_get_game_info,
-/*n*/ &snp::spi_get_performance_data,
+      (void*)&snp::spi_get_game_info,
+/*n*/ (void*)&snp::spi_get_performance_data,
       &snp::spi_initialize,
-/*e*/ &snp::spi_initialize_device,
-/*e*/ &snp::spi_lock_device_list,
-      &snp::spi_lock_game_list,
+/*e*/ (void*)&snp::spi_initialize_device,
+/*e*/ (void*)&snp::spi_lock_device_list,
+      (void*)&snp::spi_lock_game_list,
       &snp::spi_receive,
 /*n*/ &snp::spi_receive_external_message,
-/*e*/ &snp::spi_select_game,
+/*e*/ (void*)&snp::spi_select_game,
       &snp::spi_send,
-/*e*/ &snp::spi_send_external_message,
-/*n*/ &snp::spi_start_advertising_ladder_game,
+/*e*/ (void*)&snp::spi_send_external_message,
+/*n*/ (void*)&snp::spi_start_advertising_ladder_game,
 /*n*/ &snp::spi_stop_advertising_game,
 /*e*/ &snp::spi_unlock_device_list,
-      &snp::spi_unlock_game_list,
+      (void*)&snp::spi_unlock_game_list,
 	  nullptr,
 	  nullptr,
 	  nullptr,
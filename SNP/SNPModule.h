@@ -1,7 +1,5 @@
 #pragma once
 #include "Common.h"
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
 //#include "SyncQueue.h"
 
 namespace snp {
@@ -0,0 +1,105 @@
+#include "SendScheduler.h"
+
+// How much unused capacity an idle link may bank, lets a short bulk burst through without pacing
+constexpr auto MAX_BURST = 20ms;
+
+SendScheduler::SendScheduler(const SchedulerConfig& config, Send send)
+: m_config{config}, m_send{std::move(send)}, m_pace_kbps{std::clamp(config.bulk_kbps, config.min_kbps, config.max_kbps)} {}
+
+bool SendScheduler::is_urgent(StormPacketClass packet_class) {
+	switch (packet_class) {
+		case StormPacketClass::Ack:
+		case StormPacketClass::ResendRequest:
+		case StormPacketClass::Keepalive:
+		case StormPacketClass::Ping:
+		case StormPacketClass::Turn:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void SendScheduler::send(const char* data, size_t size, StormPacketClass packet_class) {
+	std::lock_guard lock{m_mutex};
+	if (m_closed) {
+		return;
+	}
+
+	const auto now = Clock::now();
+	m_link_free_at = std::max(m_link_free_at, now - MAX_BURST);
+	if (is_urgent(packet_class)) {
+		m_stats.urgent++;
+		transmit(data, size);
+		return;
+	}
+
+	m_stats.bulk++;
+	if (m_bulk.empty() && m_link_free_at <= now) {
+		transmit(data, size);
+		return;
+	}
+
+	if (m_link_free_at - now > std::chrono::milliseconds{m_config.max_queue_ms}) {
+		m_stats.dropped++;
+		return;
+	}
+	m_stats.delayed++;
+	m_bulk.emplace_back(now, std::string{data, size});
+	schedule_drain();
+}
+
+void SendScheduler::handle_loss_report(f64 loss) {
+	// Back off quickly when the peer sees loss, probe upwards slowly while it does not
+	const auto pace = m_pace_kbps.load();
+	const auto next = loss > 0.01 ? pace * 0.85 : loss == 0 ? pace * 1.05 : pace;
+	m_pace_kbps = std::clamp((u32)next, m_config.min_kbps, m_config.max_kbps);
+}
+
+void SendScheduler::close() {
+	std::lock_guard lock{m_mutex};
+	m_closed = true;
+	m_bulk.clear();
+}
+
+SchedulerStats SendScheduler::stats() {
+	std::lock_guard lock{m_mutex};
+	return m_stats;
+}
+
+void SendScheduler::transmit(const char* data, size_t size) {
+	// Urgent packets use up capacity too, bulk waits for them instead of the other way around
+	m_link_free_at += std::chrono::microseconds{size * 8000 / m_pace_kbps};
+	m_send(data, size);
+}
+
+void SendScheduler::drain() {
+	std::lock_guard lock{m_mutex};
+	m_drain_scheduled = false;
+	if (m_closed) {
+		return;
+	}
+
+	const auto now = Clock::now();
+	while (!m_bulk.empty() && m_link_free_at <= now) {
+		const auto& [queued_at, packet] = m_bulk.front();
+		if (now - queued_at > std::chrono::milliseconds{m_config.max_queue_ms}) {
+			m_stats.dropped++;
+		} else {
+			transmit(packet.data(), packet.size());
+		}
+		m_bulk.pop_front();
+	}
+	schedule_drain();
+}
+
+void SendScheduler::schedule_drain() {
+	if (m_drain_scheduled || m_bulk.empty()) {
+		return;
+	}
+	m_drain_scheduled = true;
+	TaskScheduler::instance().schedule(m_link_free_at, [weak = weak_from_this()] {
+		if (auto self = weak.lock()) {
+			self->drain();
+		}
+	});
+}
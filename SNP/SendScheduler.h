@@ -0,0 +1,58 @@
+#pragma once
+#include "Common.h"
+#include "TaskScheduler.h"
+#include <deque>
+
+struct SchedulerConfig {
+	bool enabled = false;
+	u32 bulk_kbps = 512;     // initial pace for bulk traffic, adapted to the peer's loss reports
+	u32 min_kbps = 64;
+	u32 max_kbps = 8192;
+	u32 max_queue_ms = 1000; // bulk packets that would wait longer are dropped, Storm resends them
+};
+
+struct SchedulerStats {
+	u64 urgent = 0;
+	u64 bulk = 0;
+	u64 delayed = 0;
+	u64 dropped = 0;
+};
+
+// Per peer send scheduling: turns, acks, keepalives and pings go out immediately while bulk
+// (lobby messages, map transfer, system traffic) is paced to the link capacity, so it never fills
+// the uplink queue that the next turn packet has to wait in
+class SendScheduler : public std::enable_shared_from_this<SendScheduler> {
+public:
+	using Clock = TaskScheduler::Clock;
+	using Send = std::function<void(const char* data, size_t size)>;
+
+	SendScheduler(const SchedulerConfig& config, Send send);
+
+	SendScheduler(const SendScheduler&) = delete;
+	SendScheduler& operator=(const SendScheduler&) = delete;
+
+	void send(const char* data, size_t size, StormPacketClass packet_class);
+	void handle_loss_report(f64 loss);
+	// Stops sending, must be called before whatever send refers to goes away
+	void close();
+
+	u32 pace_kbps() const { return m_pace_kbps; }
+	SchedulerStats stats();
+
+private:
+	static bool is_urgent(StormPacketClass packet_class);
+	void transmit(const char* data, size_t size);
+	void drain();
+	void schedule_drain();
+
+private:
+	const SchedulerConfig m_config;
+	Send m_send;
+	std::atomic<u32> m_pace_kbps;
+	std::deque<std::pair<Clock::time_point, std::string>> m_bulk;
+	Clock::time_point m_link_free_at{};
+	bool m_drain_scheduled = false;
+	bool m_closed = false;
+	SchedulerStats m_stats;
+	std::mutex m_mutex;
+};
@@ -1,4 +1,4 @@
-#include "signaling.h"
+#include "Signaling.h"
 
 void to_json(Json& out_json, const SignalPacket& packet) {
 	try {
@@ -15,8 +15,11 @@ void to_json(Json& out_json, const SignalPacket& packet) {
 
 void from_json(const Json& json, SignalPacket& out_packet) {
 	try {
-		auto tempstr = json.at("peer_id").get<std::string>();
-		out_packet.peer_address = base64::from_base64(tempstr);
+		const auto& peer_id = json.at("peer_id").get_ref<const std::string&>();
+		// Anything but a peer ID (the server's own messages) takes the general path as before
+		if (!fast_base64::decode_address(peer_id, out_packet.peer_address.bytes)) {
+			out_packet.peer_address = fast_base64::from_base64(peer_id);
+		}
 		json.at("message_type").get_to(out_packet.message_type);
 		json.at("data").get_to(out_packet.data);
 	} catch (const Json::exception& ex) {
@@ -49,7 +52,7 @@ bool SignalingSocket::try_init() {
 		}
 
 		if (connect(m_socket, info->ai_addr, info->ai_addrlen) == -1) {
-			closesocket(m_socket);
+			platform::close_socket(m_socket);
 			spdlog::dump_backtrace();
 			spdlog::error("Client: Couldn't connect to server: {}", std::strerror(errno));
 			continue;
@@ -75,7 +78,7 @@ bool SignalingSocket::try_init() {
 
 void SignalingSocket::deinit() {
 	if (m_socket) {
-		closesocket(m_socket);
+		platform::close_socket(m_socket);
 		m_socket = 0;
 	}
 }
@@ -104,6 +107,36 @@ void SignalingSocket::send_packet(const SignalPacket& packet) {
 	}
 }
 
+void SignalingSocket::post_packet(NetAddress destination, SignalMessageType message_type, std::string message) {
+	{
+		std::lock_guard lock{m_posted_mutex};
+		m_posted.emplace_back(destination, message_type, std::move(message));
+		if (!m_sender.joinable()) {
+			m_sender = std::jthread{[this](std::stop_token stop) { send_posted(stop); }};
+		}
+	}
+	m_posted_cv.notify_one();
+}
+
+void SignalingSocket::send_posted(std::stop_token stop) {
+	std::unique_lock lock{m_posted_mutex};
+	while (m_posted_cv.wait(lock, stop, [this] { return !m_posted.empty(); })) {
+		auto packets = std::exchange(m_posted, {});
+		lock.unlock();
+		for (const auto& packet : packets) {
+			send_packet(packet);
+		}
+		lock.lock();
+	}
+}
+
+void SignalingSocket::stop_sending() {
+	if (m_sender.joinable()) {
+		m_sender.request_stop();
+		m_sender.join();
+	}
+}
+
 void SignalingSocket::split_into_packets(const std::string& data, std::vector<SignalPacket>& incoming_packets) {
 	size_t pos_start = 0;
 	size_t pos_end = 0;
@@ -124,6 +157,55 @@ void SignalingSocket::split_into_packets(const std::string& data, std::vector<Si
 	}
 }
 
+bool SignalingSocket::wait_for_data(std::chrono::milliseconds timeout) {
+	if (!m_socket) {
+		return true;
+	}
+	fd_set read_set;
+	FD_ZERO(&read_set);
+	FD_SET(m_socket, &read_set);
+	if (m_wake_socket) {
+		FD_SET(m_wake_socket, &read_set);
+	}
+	const auto ms = std::max<s64>(timeout.count(), 0);
+	timeval tv{(long)(ms / 1000), (long)(ms % 1000 * 1000)};
+	if (select((int)std::max(m_socket, m_wake_socket) + 1, &read_set, nullptr, nullptr, &tv) < 0) {
+		return true;
+	}
+	if (m_wake_socket && FD_ISSET(m_wake_socket, &read_set)) {
+		char byte;
+		recv(m_wake_socket, &byte, sizeof(byte), 0);
+	}
+	return FD_ISSET(m_socket, &read_set);
+}
+
+void SignalingSocket::wake() {
+	if (m_wake_socket) {
+		const char byte = 0;
+		send(m_wake_socket, &byte, sizeof(byte), 0);
+	}
+}
+
+void SignalingSocket::open_wake_socket() {
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t address_size = sizeof(address);
+	const auto wake_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (wake_socket == -1) {
+		spdlog::warn("Could not create the signaling wake socket, error {}", platform::last_socket_error());
+		return;
+	}
+	if (bind(wake_socket, (sockaddr*)&address, sizeof(address)) == -1
+			|| getsockname(wake_socket, (sockaddr*)&address, &address_size) == -1
+			|| connect(wake_socket, (sockaddr*)&address, sizeof(address)) == -1) {
+		spdlog::warn("Could not set up the signaling wake socket, error {}", platform::last_socket_error());
+		platform::close_socket(wake_socket);
+		return;
+	}
+	m_wake_socket = wake_socket;
+}
+
 s32 SignalingSocket::receive_packets(std::vector<SignalPacket>& incoming_packets) {
 	static constexpr unsigned int MAX_BUF_LENGTH = 4096;
 	std::vector<char> buffer(MAX_BUF_LENGTH);
@@ -1,7 +1,9 @@
 #pragma once
 #include "Common.h"
 #include "JuiceManager.h"
-#include "config.h"
+#include "Config.h"
+#include <thread>
+#include <condition_variable>
 
 enum class SignalMessageType {
 	StartAdvertising = 1,
@@ -14,6 +16,12 @@ enum class SignalMessageType {
 	JuciceCandidate,
 	JuiceDone,
 	JuiceTurnCredentials,
+	JuiceRelayDescription,
+	JuiceRelayCandidate,
+	JuiceRelayDone,
+	JuiceCandidateBatch,
+	JuiceRelayCandidateBatch,
+	PeerBye,
 
 	SignalingPing = 253,
 	ServerSetID = 254,
@@ -31,6 +39,12 @@ inline std::string to_string(SignalMessageType value) {
 		EnumStringCase(SignalMessageType::JuiceLocalDescription);
 		EnumStringCase(SignalMessageType::JuciceCandidate);
 		EnumStringCase(SignalMessageType::JuiceDone);
+		EnumStringCase(SignalMessageType::JuiceRelayDescription);
+		EnumStringCase(SignalMessageType::JuiceRelayCandidate);
+		EnumStringCase(SignalMessageType::JuiceRelayDone);
+		EnumStringCase(SignalMessageType::JuiceCandidateBatch);
+		EnumStringCase(SignalMessageType::JuiceRelayCandidateBatch);
+		EnumStringCase(SignalMessageType::PeerBye);
 
 		EnumStringCase(SignalMessageType::SignalingPing);
 		EnumStringCase(SignalMessageType::ServerSetID);
@@ -67,7 +81,7 @@ struct SignalPacket {
 		: peer_address{address}, message_type{type}, data{std::move(data)} {}
 	
 	SignalPacket(const std::string& packet_string) {
-		memcpy_s((void*)&peer_address.bytes, sizeof(peer_address.bytes), packet_string.c_str(), sizeof(NetAddress));
+		memcpy(&peer_address.bytes, packet_string.c_str(), std::min(packet_string.size(), sizeof(NetAddress)));
 		message_type = SignalMessageType{(int)packet_string.at(16) - 48};
 		data = packet_string.substr(sizeof(NetAddress) + 1);
 	}
@@ -75,18 +89,28 @@ struct SignalPacket {
 
 class SignalingSocket {
 public:
-	SignalingSocket() = default;
+	SignalingSocket() { open_wake_socket(); }
 	SignalingSocket(SignalingSocket&) = delete;
 	SignalingSocket& operator=(SignalingSocket&) = delete;
 
 	~SignalingSocket() {
+		stop_sending();
 		deinit();
+		if (m_wake_socket) {
+			platform::close_socket(m_wake_socket);
+		}
 	}
 
 	bool try_init();
 	void deinit();
 	void send_packet(NetAddress destination, SignalMessageType message_type, const std::string& message = "");
 	void send_packet(const SignalPacket& packet);
+	// Queues the packet for the sender thread, safe to call from libjuice callbacks
+	void post_packet(NetAddress destination, SignalMessageType message_type, std::string message = "");
+	// False if nothing arrived before the timeout, errors return true so receive_packets reports them
+	bool wait_for_data(std::chrono::milliseconds timeout);
+	// Makes a wait_for_data in progress return early, from any thread
+	void wake();
 	s32 receive_packets(std::vector<SignalPacket>& incoming_packets);
 	void start_advertising();
 	void stop_advertising();
@@ -97,6 +121,9 @@ public:
 	
 private:
 	void split_into_packets(const std::string& s, std::vector<SignalPacket>& incoming_packets);
+	void send_posted(std::stop_token stop);
+	void stop_sending();
+	void open_wake_socket();
 
 private:
 	inline static const std::string Delimiter = "-+";
@@ -104,8 +131,15 @@ private:
 	NetAddress m_server{};
 	std::atomic<SocketState> m_current_state = SocketState::Uninitialized;
 	SOCKET m_socket = 0;
+	// Loopback UDP socket connected to itself, select watches it next to m_socket
+	SOCKET m_wake_socket = 0;
 	s32 m_state = 0;
 	std::string m_host;
 	std::string m_port;
 	std::mutex m_mutex;
+
+	std::vector<SignalPacket> m_posted;
+	std::mutex m_posted_mutex;
+	std::condition_variable_any m_posted_cv;
+	std::jthread m_sender;
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "TaskScheduler.h"
+
+TaskScheduler& TaskScheduler::instance() {
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+TaskScheduler::TaskScheduler() {
+	m_thread = std::jthread{[this](std::stop_token stop) { run(stop); }};
+}
+
+TaskScheduler::~TaskScheduler() {
+	m_thread.request_stop();
+	m_cv.notify_all();
+}
+
+void TaskScheduler::schedule(Clock::time_point due, std::function<void()> task) {
+	{
+		std::lock_guard lock{m_mutex};
+		m_tasks.push(Task{due, m_next_order++, std::move(task)});
+	}
+	m_cv.notify_one();
+}
+
+void TaskScheduler::run(std::stop_token stop) {
+	std::unique_lock lock{m_mutex};
+	while (!stop.stop_requested()) {
+		if (m_tasks.empty()) {
+			m_cv.wait(lock, stop, [this] { return !m_tasks.empty(); });
+			continue;
+		}
+
+		const auto due = m_tasks.top().due;
+		if (Clock::now() < due) {
+			m_cv.wait_until(lock, stop, due, [this, due] { return m_tasks.top().due < due; });
+			continue;
+		}
+
+		auto task = std::move(const_cast<Task&>(m_tasks.top()).task);
+		m_tasks.pop();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
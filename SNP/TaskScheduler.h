@@ -0,0 +1,36 @@
+#pragma once
+#include "Common.h"
+#include <functional>
+#include <queue>
+#include <thread>
+#include <condition_variable>
+
+// Runs delayed tasks for the transport (impairment, send pacing) on one thread, only started once something needs it
+class TaskScheduler {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static TaskScheduler& instance();
+	~TaskScheduler();
+
+	void schedule(Clock::time_point due, std::function<void()> task);
+
+private:
+	TaskScheduler();
+	void run(std::stop_token stop);
+
+	struct Task {
+		Clock::time_point due;
+		u64 order;
+		std::function<void()> task;
+
+		bool operator>(const Task& other) const { return due != other.due ? due > other.due : order > other.order; }
+	};
+
+private:
+	std::priority_queue<Task, std::vector<Task>, std::greater<Task>> m_tasks;
+	u64 m_next_order = 0;
+	std::mutex m_mutex;
+	std::condition_variable_any m_cv;
+	std::jthread m_thread;
+};
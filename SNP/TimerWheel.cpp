@@ -0,0 +1,113 @@
+#include "TimerWheel.h"
+
+u64 TimerWheel::current_tick() const {
+	return (u64)((m_now() - m_start) / TICK);
+}
+
+TimerWheel::TimerId TimerWheel::schedule(Clock::duration delay, std::function<void()> callback) {
+	bool wake = false;
+	TimerId id;
+	{
+		std::lock_guard lock{m_mutex};
+		const auto ticks = (u64)std::max<s64>(1, (s64)((delay + TICK - Clock::duration{1}) / TICK));
+		id = m_next_id++;
+		const auto due_tick = std::max(current_tick(), m_tick) + ticks;
+		m_timers.emplace(id, Timer{due_tick, std::move(callback)});
+		insert(id, due_tick);
+
+		// The advancing thread may be asleep until well after this timer is due
+		const auto due = m_start + due_tick * TICK;
+		if (m_wakeup && due < m_wait_until && std::this_thread::get_id() != m_advancing_thread) {
+			m_wait_until = due;
+			wake = true;
+		}
+	}
+	if (wake) {
+		m_wakeup();
+	}
+	return id;
+}
+
+void TimerWheel::cancel(TimerId id) {
+	std::lock_guard lock{m_mutex};
+	// The slot keeps the id until its tick comes around, it is skipped then
+	m_timers.erase(id);
+}
+
+size_t TimerWheel::size() {
+	std::lock_guard lock{m_mutex};
+	return m_timers.size();
+}
+
+void TimerWheel::insert(TimerId id, u64 due_tick) {
+	const auto delta = due_tick > m_tick ? due_tick - m_tick : 1;
+	u32 level = 0;
+	while (level + 1 < LEVELS && delta >= (u64{1} << (SLOT_BITS * (level + 1)))) {
+		level++;
+	}
+	// Beyond the top level it waits in the furthest slot and gets placed again when that comes up
+	const auto max_delta = (u64{1} << (SLOT_BITS * LEVELS)) - 1;
+	const auto tick = delta > max_delta ? m_tick + max_delta : std::max(due_tick, m_tick + 1);
+	m_slots[level][(tick >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(id);
+}
+
+TimerWheel::Clock::duration TimerWheel::advance(Clock::duration max_wait) {
+	std::vector<std::function<void()>> due;
+	{
+		std::lock_guard lock{m_mutex};
+		const auto target = current_tick();
+		if (m_timers.empty()) {
+			m_tick = std::max(m_tick, target);
+		}
+		while (m_tick < target) {
+			m_tick++;
+			// Whenever a level wraps around, the next slot of the level above moves down
+			for (u32 level = 1; level < LEVELS && ((m_tick >> (SLOT_BITS * (level - 1))) & (SLOTS - 1)) == 0; level++) {
+				auto ids = std::exchange(m_slots[level][(m_tick >> (SLOT_BITS * level)) & (SLOTS - 1)], {});
+				for (const auto id : ids) {
+					if (auto it = m_timers.find(id); it != m_timers.end()) {
+						insert(id, it->second.due_tick);
+					}
+				}
+			}
+
+			auto ids = std::exchange(m_slots[0][m_tick & (SLOTS - 1)], {});
+			for (const auto id : ids) {
+				auto it = m_timers.find(id);
+				if (it == m_timers.end()) {
+					continue;
+				}
+				if (it->second.due_tick <= m_tick) {
+					due.push_back(std::move(it->second.callback));
+					m_timers.erase(it);
+				} else {
+					insert(id, it->second.due_tick);
+				}
+			}
+		}
+	}
+
+	for (auto& callback : due) {
+		callback();
+	}
+
+	std::lock_guard lock{m_mutex};
+	const auto wait = next_wait(max_wait);
+	m_advancing_thread = std::this_thread::get_id();
+	m_wait_until = m_now() + wait;
+	return wait;
+}
+
+// Until the next occupied level 0 slot, or the next wrap that moves timers down from above if that
+// comes first, the timers it moves down may be due before anything already in level 0
+TimerWheel::Clock::duration TimerWheel::next_wait(Clock::duration max_wait) {
+	if (m_timers.empty()) {
+		return max_wait;
+	}
+	const auto next_wrap = (m_tick | (SLOTS - 1)) + 1;
+	auto next_tick = m_tick + 1;
+	while (next_tick < next_wrap && m_slots[0][next_tick & (SLOTS - 1)].empty()) {
+		next_tick++;
+	}
+	return std::min<Clock::duration>(max_wait, m_start + next_tick * TICK - m_now());
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Common.h"
+#include <functional>
+#include <thread>
+
+// Hierarchical timing wheel. Level 0 has SLOTS slots of one TICK each, every level above is SLOTS
+// times coarser, timers move down a level whenever the level below wraps around. Scheduling and
+// cancelling are O(1) and the wheel only does work for ticks that actually pass, so an idle wheel
+// costs nothing and hundreds of per-peer timers never need a full scan.
+class TimerWheel {
+public:
+	using Clock = std::chrono::steady_clock;
+	using TimerId = u64;
+	using Now = Clock::time_point (*)();
+
+	static constexpr auto TICK = std::chrono::milliseconds{10};
+	static constexpr u32 SLOT_BITS = 6;
+	static constexpr u32 SLOTS = 1 << SLOT_BITS;
+	static constexpr u32 LEVELS = 4; // 64^4 ticks, about 46 hours
+
+	// now is only replaced by benches that need hours of timers to pass instantly
+	TimerWheel(Now now = Clock::now) : m_now{now}, m_start{now()} {}
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	// Called when a timer scheduled off the advancing thread is due before its current wait ends
+	void set_wakeup(std::function<void()> wakeup) { m_wakeup = std::move(wakeup); }
+	TimerId schedule(Clock::duration delay, std::function<void()> callback);
+	void cancel(TimerId id);
+	// Runs every timer that is due on the calling thread, without holding the wheel's lock.
+	// Returns how long the caller can wait before the next timer could be due, capped at max_wait.
+	Clock::duration advance(Clock::duration max_wait);
+	size_t size();
+
+private:
+	struct Timer {
+		u64 due_tick;
+		std::function<void()> callback;
+	};
+
+	u64 current_tick() const;
+	void insert(TimerId id, u64 due_tick);
+	Clock::duration next_wait(Clock::duration max_wait);
+
+private:
+	const Now m_now;
+	const Clock::time_point m_start;
+	u64 m_tick = 0; // the last tick that was processed
+	std::vector<TimerId> m_slots[LEVELS][SLOTS];
+	std::unordered_map<TimerId, Timer> m_timers;
+	TimerId m_next_id = 1;
+	std::mutex m_mutex;
+
+	std::function<void()> m_wakeup;
+	std::thread::id m_advancing_thread;
+	Clock::time_point m_wait_until{}; // when the advancing thread looks at the wheel again
+};
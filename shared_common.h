@@ -3,11 +3,12 @@
 constexpr const char* CL_VERSION = "0.3.9";
 
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include <concepts>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
-#include <format>
 #include <initializer_list>
 #include <fstream>
 #include <chrono>
@@ -47,6 +47,12 @@ class Signal_message_type(IntEnum):
     SIGNAL_JUICE_CANDIDATE = 102
     SIGNAL_JUICE_DONE = 103
     SIGNAL_JUICE_TURN_CREDENTIALS = 104
+    SIGNAL_JUICE_RELAY_DESCRIPTION = 105
+    SIGNAL_JUICE_RELAY_CANDIDATE = 106
+    SIGNAL_JUICE_RELAY_DONE = 107
+    SIGNAL_JUICE_CANDIDATE_BATCH = 108
+    SIGNAL_JUICE_RELAY_CANDIDATE_BATCH = 109
+    SIGNAL_PEER_BYE = 110
     SIGNAL_PING = 253
     SERVER_SET_ID = 254
     SERVER_ECHO = 255